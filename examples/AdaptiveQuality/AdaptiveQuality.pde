@@ -0,0 +1,34 @@
+/**
+ *  Lowers the video's quality while the sketch is too busy to keep up,
+ *  and raises it again once there is headroom.
+ *  Hold down the mouse button to simulate a heavy workload.
+ */
+
+import gohai.glvideo.*;
+GLMovie video;
+
+void setup() {
+  size(560, 406, P2D);
+  // SCALABLE lets the resolution be lowered as well
+  video = new GLMovie(this, "launch1.mp4", GLVideo.SCALABLE);
+  video.adaptiveQuality(true);
+  video.loop();
+}
+
+void draw() {
+  background(0);
+  if (video.available()) {
+    video.read();
+  }
+  image(video, 0, 0, width, height);
+
+  if (mousePressed) {
+    delay(80);
+  }
+
+  long[] stats = video.adaptiveStats();
+  fill(255);
+  text("Quality level: " + stats[0] + " (down " + stats[1] + ", up " + stats[2] + ")", 10, 20);
+  text("Frames missed: " + stats[3] + ", dropped: " + stats[4], 10, 40);
+  text("Read latency: " + stats[5] / 1000 + " ms, lateness: " + stats[6] / 1000 + " ms", 10, 60);
+}
@@ -0,0 +1,119 @@
+/**
+ *  Opens, plays and closes a video over and over, and logs the
+ *  resources used by the library to soak.csv in the sketch folder.
+ *  Once done, the sketch exits with an error if file descriptors,
+ *  threads, textures or memory kept growing after the first few
+ *  iterations, or if a pipeline wasn't closed.
+ *  Run "ant soak" to run this headless, on software OpenGL.
+ *  The number of iterations can be passed as an argument.
+ */
+
+import gohai.glvideo.*;
+
+int ITERATIONS = 1000;
+int WARMUP = 50;
+int LOG_EVERY = 25;
+int FRAMES_PER_CLIP = 10;
+int TIMEOUT = 5000;  // ms
+float MAX_RSS_GROWTH = 1.25;
+int MAX_FD_GROWTH = 4;
+int MAX_THREAD_GROWTH = 4;
+
+GLMovie video;
+int iteration = 0;
+int frames;
+int timeouts = 0;
+int openedAt;
+long[] baseline;
+PrintWriter log;
+
+void setup() {
+  size(320, 180, P2D);
+  if (args != null && 0 < args.length) {
+    ITERATIONS = int(args[0]);
+  }
+  log = createWriter("soak.csv");
+  log.println("iteration,opened,closed,failed,open,avg_open_us,max_open_us,avg_first_frame_us,max_first_frame_us,textures,gl_objects,rss,fds,threads");
+}
+
+void draw() {
+  background(0);
+
+  if (video == null) {
+    video = new GLMovie(this, "launch1.mp4", GLVideo.MUTE);
+    video.play();
+    frames = 0;
+    openedAt = millis();
+  }
+
+  if (video.available()) {
+    video.read();
+    frames++;
+  }
+  image(video, 0, 0, width, height);
+
+  if (FRAMES_PER_CLIP <= frames || TIMEOUT < millis() - openedAt) {
+    if (frames < FRAMES_PER_CLIP) {
+      timeouts++;
+    }
+    video.close();
+    video = null;
+    iteration++;
+
+    if (iteration == WARMUP) {
+      baseline = GLVideo.resourceStats();
+    }
+    if (iteration % LOG_EVERY == 0) {
+      logStats(GLVideo.resourceStats());
+    }
+    if (iteration == ITERATIONS) {
+      finish();
+    }
+  }
+}
+
+void logStats(long[] stats) {
+  String line = str(iteration);
+  for (int i=0; i < stats.length; i++) {
+    line += "," + stats[i];
+  }
+  log.println(line);
+  log.flush();
+  println(iteration + ": " + stats[3] + " open, " + stats[8] + " textures, rss " + stats[10] / 1024 + " KB, " + stats[11] + " fds, " + stats[12] + " threads, open " + stats[4] + " us, first frame " + stats[6] + " us");
+}
+
+void finish() {
+  long[] stats = GLVideo.resourceStats();
+  boolean failed = false;
+
+  if (stats[3] != 0) {
+    println("FAIL: " + stats[3] + " pipelines still open");
+    failed = true;
+  }
+  if (stats[8] != 0) {
+    println("FAIL: " + stats[8] + " video textures still held");
+    failed = true;
+  }
+  if (baseline != null) {
+    if (0 < baseline[10] && baseline[10] * MAX_RSS_GROWTH < stats[10]) {
+      println("FAIL: resident memory grew from " + baseline[10] / 1024 + " KB to " + stats[10] / 1024 + " KB");
+      failed = true;
+    }
+    if (0 <= baseline[11] && baseline[11] + MAX_FD_GROWTH < stats[11]) {
+      println("FAIL: file descriptors grew from " + baseline[11] + " to " + stats[11]);
+      failed = true;
+    }
+    if (0 <= baseline[12] && baseline[12] + MAX_THREAD_GROWTH < stats[12]) {
+      println("FAIL: threads grew from " + baseline[12] + " to " + stats[12]);
+      failed = true;
+    }
+  }
+  println(iteration + " iterations, " + stats[2] + " failed to open, " + timeouts + " timed out");
+
+  log.close();
+  if (failed || 0 < stats[2]) {
+    System.exit(1);
+  } else {
+    exit();
+  }
+}
@@ -0,0 +1,78 @@
+/**
+ *  Opens one more video every few seconds, and prints the number
+ *  of threads and the CPU load of the process for each step.
+ *  Run it once with the default of one shared GL context, and once
+ *  with sharedContexts(0), which gives every video its own GL
+ *  context and thread, to compare.
+ *
+ *  This reads /proc/self/status, and therefore only works on Linux.
+ */
+
+import gohai.glvideo.*;
+import java.lang.management.ManagementFactory;
+
+int MAX_STREAMS = 12;
+int STEP_MILLIS = 5000;
+
+ArrayList<GLMovie> videos = new ArrayList<GLMovie>();
+int lastStep;
+long lastCpuTime;
+
+void setup() {
+  size(640, 360, P2D);
+  // try 0 (one context per video), 1 (default) or more
+  GLVideo.sharedContexts(1);
+  println("streams\tthreads\tcpu%");
+  addVideo();
+}
+
+void draw() {
+  background(0);
+
+  int cols = ceil(sqrt(videos.size()));
+  int rows = ceil(videos.size() / (float)cols);
+  for (int i=0; i < videos.size(); i++) {
+    GLMovie video = videos.get(i);
+    if (video.available()) {
+      video.read();
+    }
+    image(video, (i % cols) * width/cols, (i / cols) * height/rows, width/cols, height/rows);
+  }
+
+  if (STEP_MILLIS < millis() - lastStep) {
+    report();
+    if (videos.size() < MAX_STREAMS) {
+      addVideo();
+    } else {
+      exit();
+    }
+  }
+}
+
+void addVideo() {
+  GLMovie video = new GLMovie(this, "launch1.mp4", GLVideo.MUTE);
+  video.loop();
+  videos.add(video);
+  lastStep = millis();
+  lastCpuTime = processCpuTime();
+}
+
+void report() {
+  long cpuTime = processCpuTime();
+  float cpu = 100.0 * (cpuTime - lastCpuTime) / ((millis() - lastStep) * 1000000.0);
+  println(videos.size() + "\t" + threadCount() + "\t" + nf(cpu, 0, 1));
+}
+
+long processCpuTime() {
+  return ((com.sun.management.OperatingSystemMXBean)ManagementFactory.getOperatingSystemMXBean()).getProcessCpuTime();
+}
+
+int threadCount() {
+  // this includes native threads, unlike Thread.activeCount()
+  for (String line : loadStrings("/proc/self/status")) {
+    if (line.startsWith("Threads:")) {
+      return int(trim(line.substring(8)));
+    }
+  }
+  return -1;
+}
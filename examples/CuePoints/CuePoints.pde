@@ -0,0 +1,40 @@
+/**
+ *  Flashes the screen at given times of a looping video.
+ *  The cues are fired by the pipeline's clock, independent of
+ *  the sketch's frame rate, so they could e.g. trigger sounds or
+ *  DMX lighting with sub-millisecond precision.
+ */
+
+import gohai.glvideo.*;
+GLMovie video;
+volatile int lastCue = -1;
+volatile int lastCueMillis = 0;
+
+void setup() {
+  size(560, 406, P2D);
+  video = new GLMovie(this, "launch1.mp4");
+  video.cues(1.0, 2.5, 4.0);
+  video.loop();
+}
+
+void draw() {
+  background(0);
+  if (video.available()) {
+    video.read();
+  }
+  image(video, 0, 0, width, height);
+
+  if (millis() - lastCueMillis < 100) {
+    fill(255, 128);
+    rect(0, 0, width, height);
+  }
+  fill(255);
+  text("Last cue: " + lastCue, 10, 20);
+}
+
+// this is called on a different thread than draw
+void cueEvent(GLVideo video, int cue, float time) {
+  println("Cue " + cue + " at " + nf(time, 0, 4) + " s");
+  lastCue = cue;
+  lastCueMillis = millis();
+}
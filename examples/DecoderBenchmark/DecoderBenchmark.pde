@@ -0,0 +1,59 @@
+/**
+ *  Compares how fast different software decoding configurations
+ *  decode a 1080p and a 4K video, without syncing to the clock.
+ *
+ *  Add two H.264 files named 1080p.mp4 and 4k.mp4 to the sketch's
+ *  data folder first. You can create them e.g. like this:
+ *  gst-launch-1.0 videotestsrc num-buffers=900 pattern=ball ! video/x-raw,width=1920,height=1080,framerate=30/1 ! x264enc ! mp4mux ! filesink location=1080p.mp4
+ *  gst-launch-1.0 videotestsrc num-buffers=900 pattern=ball ! video/x-raw,width=3840,height=2160,framerate=30/1 ! x264enc ! mp4mux ! filesink location=4k.mp4
+ */
+
+import gohai.glvideo.*;
+
+String[] files = { "1080p.mp4", "4k.mp4" };
+// decoder threads, 0 is the decoder's default
+int[] threads = { 0, 1, 2, 4, 8 };
+int RUN_MILLIS = 5000;
+
+int run = 0;
+GLMovie video;
+int started;
+float startTime;
+
+void setup() {
+  size(640, 360, P2D);
+  // make sure a software decoder gets used
+  GLVideo.preferDecoders("avdec_h264");
+  GLVideo.decoderQueue(2.0);
+  println("file\tthreads\tdecoder\trealtime");
+  startRun();
+}
+
+void draw() {
+  background(0);
+  if (video.available()) {
+    video.read();
+  }
+  image(video, 0, 0, width, height);
+
+  if (RUN_MILLIS < millis() - started) {
+    // how much faster than real time the video got decoded
+    float factor = (video.time() - startTime) / ((millis() - started) / 1000.0);
+    println(files[run / threads.length] + "\t" + threads[run % threads.length] + "\t" + video.decoder() + "\t" + nf(factor, 0, 2) + "x");
+    video.close();
+    run++;
+    if (run < files.length * threads.length) {
+      startRun();
+    } else {
+      exit();
+    }
+  }
+}
+
+void startRun() {
+  GLVideo.decoderThreads(threads[run % threads.length]);
+  video = new GLMovie(this, files[run / threads.length], GLVideo.NO_SYNC | GLVideo.MUTE);
+  video.play();
+  started = millis();
+  startTime = video.time();
+}
@@ -0,0 +1,58 @@
+/**
+ *  Measures the time spent per frame in calls a typical sketch makes
+ *  on each of 16 videos, with and without the shared frame descriptor.
+ *  The two modes alternate every few seconds, and the averages are
+ *  printed to the console.
+ */
+
+import gohai.glvideo.*;
+
+int NUM_VIDEOS = 16;
+int FRAMES_PER_MODE = 300;
+
+GLMovie[] videos = new GLMovie[NUM_VIDEOS];
+boolean useDescriptor = true;
+long elapsed = 0;
+int frames = 0;
+float sink;
+
+void setup() {
+  size(640, 360, P2D);
+  for (int i=0; i < videos.length; i++) {
+    videos[i] = new GLMovie(this, "launch1.mp4", GLVideo.MUTE);
+    videos[i].frameDescriptor(useDescriptor);
+    videos[i].loop();
+  }
+  println("mode\tus per frame");
+}
+
+void draw() {
+  background(0);
+
+  long start = System.nanoTime();
+  for (int i=0; i < videos.length; i++) {
+    GLMovie video = videos[i];
+    if (video.available()) {
+      video.read();
+    }
+    // keep the results, so that the calls don't get optimized away
+    sink += video.width() + video.height() + video.time() + video.duration() + (video.playing() ? 1 : 0);
+  }
+  elapsed += System.nanoTime() - start;
+  frames++;
+
+  int cols = 4;
+  for (int i=0; i < videos.length; i++) {
+    image(videos[i], (i % cols) * width/cols, (i / cols) * height/cols, width/cols, height/cols);
+  }
+
+  if (frames == FRAMES_PER_MODE) {
+    println((useDescriptor ? "descriptor" : "jni") + "\t" + nf(elapsed / 1000.0 / frames, 0, 1));
+    useDescriptor = !useDescriptor;
+    for (int i=0; i < videos.length; i++) {
+      videos[i].frameDescriptor(useDescriptor);
+    }
+    elapsed = 0;
+    frames = 0;
+  }
+}
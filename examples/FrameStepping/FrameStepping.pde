@@ -0,0 +1,31 @@
+/**
+ *  Steps through a video one frame at a time.
+ *  Use the right and left arrow keys to step forward and backward.
+ */
+
+import gohai.glvideo.*;
+GLMovie video;
+float pts = 0;
+
+void setup() {
+  size(560, 406, P2D);
+  video = new GLMovie(this, "launch1.mp4");
+}
+
+void draw() {
+  background(0);
+  if (video.available()) {
+    video.read();
+  }
+  image(video, 0, 0, width, height);
+  fill(255);
+  text(nf(pts, 0, 3) + " s", 10, 20);
+}
+
+void keyPressed() {
+  if (keyCode == RIGHT) {
+    pts = video.step(1);
+  } else if (keyCode == LEFT) {
+    pts = video.step(-1);
+  }
+}
@@ -0,0 +1,37 @@
+/**
+ *  Captures 1280x720 at 30 fps from the first camera.
+ *  Many USB cameras only deliver uncompressed frames at low framerates
+ *  for larger sizes, but Motion JPEG at full rate. The library picks
+ *  the format that reaches the requested framerate, and decodes JPEG
+ *  frames on multiple threads if necessary.
+ */
+
+import gohai.glvideo.*;
+GLCapture video;
+
+void setup() {
+  size(1280, 720, P2D);
+
+  String[] devices = GLCapture.list();
+  if (devices.length == 0) {
+    println("No capture devices found");
+    exit();
+    return;
+  }
+
+  video = new GLCapture(this, devices[0], 1280, 720, 30);
+  video.start();
+  println("Format: " + video.format());
+}
+
+void draw() {
+  background(0);
+  if (video.available()) {
+    video.read();
+  }
+  image(video, 0, 0, width, height);
+
+  if (frameCount % 120 == 0) {
+    println("Decoder: " + video.decoder() + ", " + nf(frameRate, 0, 1) + " fps");
+  }
+}
@@ -0,0 +1,56 @@
+/**
+ *  Detects motion in front of the camera.
+ *  The analysis happens natively for every frame the camera captures,
+ *  so the sketch only needs to draw the results: the cells that changed,
+ *  the area of motion, and a histogram of the brightness.
+ */
+
+import gohai.glvideo.*;
+GLCapture video;
+
+int GRID_W = 32;
+int GRID_H = 24;
+
+void setup() {
+  size(640, 480, P2D);
+  video = new GLCapture(this);
+  video.start();
+  video.frameAnalysis(GRID_W, GRID_H, 24);
+}
+
+void draw() {
+  background(0);
+  if (video.available()) {
+    video.read();
+  }
+  image(video, 0, 0, width, height);
+
+  // cells that changed since the previous frame
+  int[] diff = video.difference();
+  noStroke();
+  for (int i=0; i < diff.length; i++) {
+    if (24 < diff[i]) {
+      fill(255, 0, 0, diff[i]);
+      rect((i % GRID_W) * width / GRID_W, (i / GRID_W) * height / GRID_H, width / GRID_W, height / GRID_H);
+    }
+  }
+
+  // area of motion, in the video's pixels
+  int[] motion = video.motion();
+  if (0 < motion[2] && 0 < video.width() && 0 < video.height()) {
+    float sx = width / (float) video.width();
+    float sy = height / (float) video.height();
+    noFill();
+    stroke(255, 255, 0);
+    rect(motion[0] * sx, motion[1] * sy, motion[2] * sx, motion[3] * sy);
+  }
+
+  // brightness histogram
+  int[] hist = video.histogram();
+  int peak = max(hist);
+  stroke(255);
+  for (int i=0; i < hist.length; i++) {
+    float h = (0 < peak) ? hist[i] * 80.0 / peak : 0;
+    line(i * width / 256.0, height, i * width / 256.0, height - h);
+  }
+}
@@ -0,0 +1,37 @@
+/**
+ *  Plays a video over HTTP, and displays statistics about buffering.
+ *
+ *  To try this with limited bandwidth, serve this sketch's data folder
+ *  from a local HTTP server that is throttled, e.g. using trickle:
+ *  cd data && trickle -s -u 200 python3 -m http.server 8000
+ *
+ *  The video will pause for buffering once less than 10% of the buffer
+ *  is filled, and resume once it is full again. Try different
+ *  watermarks below to compare.
+ */
+
+import gohai.glvideo.*;
+GLMovie video;
+
+void setup() {
+  size(560, 406, P2D);
+  // buffer up to 8 MB of the stream
+  GLVideo.ringBufferSize(8 * 1024 * 1024);
+  video = new GLMovie(this, "http://localhost:8000/launch2.mp4", GLVideo.DOWNLOAD);
+  video.bufferingWatermarks(10, 100);
+  video.loop();
+}
+
+void draw() {
+  background(0);
+  if (video.available()) {
+    video.read();
+  }
+  image(video, 0, 0, width, height);
+
+  long[] stats = video.bufferingStats();
+  fill(255);
+  text("Buffer: " + stats[0] + "%", 10, 20);
+  text("Paused for buffering: " + stats[1] + " times, " + stats[2] + " ms", 10, 40);
+  text("Rate in/out: " + stats[3] / 1024 + " / " + stats[4] / 1024 + " KB/s", 10, 60);
+}
@@ -0,0 +1,38 @@
+/**
+ *  Like Video Edge Detect, but the shader is applied inside the
+ *  GStreamer pipeline, rather than when drawing the video.
+ *  Move the mouse horizontally to change the strength of the effect,
+ *  click to add or remove it.
+ */
+
+import gohai.glvideo.*;
+
+GLMovie video;
+int edges = -1;
+
+void setup() {
+  size(560, 406, P2D);
+  video = new GLMovie(this, "launch2.mp4");
+  video.loop();
+  edges = video.addShader("edges.frag");
+}
+
+void draw() {
+  background(0);
+  if (video.available()) {
+    video.read();
+  }
+  if (edges != -1) {
+    video.uniform(edges, "strength", mouseX / (float) width);
+  }
+  image(video, 0, 0, width, height);
+}
+
+void mousePressed() {
+  if (edges != -1) {
+    video.removeShader(edges);
+    edges = -1;
+  } else {
+    edges = video.addShader("edges.frag");
+  }
+}
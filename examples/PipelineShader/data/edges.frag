@@ -0,0 +1,27 @@
+#ifdef GL_ES
+precision mediump float;
+#endif
+
+// set by glshader
+varying vec2 v_texcoord;
+uniform sampler2D tex;
+uniform float width;
+uniform float height;
+
+// set by the sketch
+uniform float strength;
+
+void main() {
+  vec2 d = vec2(1.0 / width, 1.0 / height);
+  vec4 col = texture2D(tex, v_texcoord);
+  vec4 sum = 8.0 * col;
+  sum -= texture2D(tex, v_texcoord + vec2(-d.x, -d.y));
+  sum -= texture2D(tex, v_texcoord + vec2( 0.0, -d.y));
+  sum -= texture2D(tex, v_texcoord + vec2( d.x, -d.y));
+  sum -= texture2D(tex, v_texcoord + vec2(-d.x,  0.0));
+  sum -= texture2D(tex, v_texcoord + vec2( d.x,  0.0));
+  sum -= texture2D(tex, v_texcoord + vec2(-d.x,  d.y));
+  sum -= texture2D(tex, v_texcoord + vec2( 0.0,  d.y));
+  sum -= texture2D(tex, v_texcoord + vec2( d.x,  d.y));
+  gl_FragColor = vec4(mix(col.rgb, sum.rgb, strength), 1.0);
+}
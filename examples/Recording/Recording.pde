@@ -0,0 +1,37 @@
+/**
+ *  Records the sketch's output to a video file.
+ *  Press any key to stop recording, the file output.mp4 will be
+ *  saved in the sketch folder.
+ */
+
+import gohai.glvideo.*;
+GLRecorder recorder;
+
+void setup() {
+  size(640, 360, P2D);
+  frameRate(30);
+  recorder = new GLRecorder(this, "output.mp4", 30);
+  // keep up to 8 frames waiting to be encoded, and drop frames beyond that
+  recorder.queue(8, GLRecorder.DROP);
+  recorder.start();
+}
+
+void draw() {
+  background(0);
+  noStroke();
+  for (int i=0; i < 20; i++) {
+    fill(255, i * 12, 0);
+    float angle = frameCount * 0.02 + i * TWO_PI / 20;
+    ellipse(width/2 + cos(angle) * 120, height/2 + sin(angle * 2) * 120, 30, 30);
+  }
+
+  if (frameCount % 30 == 0) {
+    long[] stats = recorder.stats();
+    println("recorded " + stats[0] + ", dropped " + stats[1] + ", queued " + stats[2]);
+  }
+}
+
+void keyPressed() {
+  recorder.stop();
+  println("Done");
+}
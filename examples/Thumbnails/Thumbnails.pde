@@ -0,0 +1,40 @@
+/**
+ *  Extracts thumbnails at ten timestamps from a couple of videos,
+ *  and prints how many thumbnails per second were extracted.
+ *  Press any key to switch between keyframes and exact timestamps.
+ */
+
+import gohai.glvideo.*;
+GLThumbnailer thumbnailer;
+String[] files = { "launch1.mp4", "launch2.mp4", "launch3.mp4" };
+float[] times = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+PImage[][] thumbnails;
+boolean exact = false;
+
+void setup() {
+  size(640, 216, P2D);
+  thumbnailer = new GLThumbnailer(this, 64, 36);
+  extract();
+}
+
+void draw() {
+  background(0);
+  for (int i=0; i < thumbnails.length; i++) {
+    for (int j=0; j < thumbnails[i].length; j++) {
+      if (thumbnails[i][j] != null) {
+        image(thumbnails[i][j], j * 64, i * 72);
+      }
+    }
+  }
+}
+
+void keyPressed() {
+  exact = !exact;
+  extract();
+}
+
+void extract() {
+  thumbnailer.exact(exact);
+  thumbnails = thumbnailer.extract(files, times);
+  println((exact ? "exact: " : "keyframes: ") + thumbnailer.extracted() + " thumbnails, " + nf(thumbnailer.throughput(), 0, 1) + " per second");
+}
@@ -6,7 +6,6 @@
 import gohai.glvideo.GLMovie;
 import gohai.glvideo.PerspectiveTransform;
 import gohai.glvideo.WarpPerspective;
-import java.awt.geom.Point2D;
 
 PImage[] sources = new PImage[2];
 int selSource = 0;
@@ -14,7 +13,8 @@ GLMovie video;
 
 PVector corners[] = new PVector[4];
 int selCorner = -1;
-PShape quads[];
+WarpPerspective warp;
+PShape mesh;
 int res = 5;	// number of subdivisions (e.g. 5x5)
 
 int lastMouseMove = 0;
@@ -33,7 +33,8 @@ void setup() {
   corners[2] = new PVector(width/2 + 100, height/2 + 100);
   corners[3] = new PVector(width/2 - 100, height/2 + 100);
 
-  quads = createMesh(sources[selSource], corners, res);
+  // the video's size isn't known before its first frame, so the
+  // mesh gets created in draw
 }
 
 void draw() {
@@ -42,24 +43,25 @@ void draw() {
   if (selSource == 0 && video.available()) {
     video.read();
   }
+  if (mesh == null) {
+    if (sources[selSource].width == 0) {
+      return;
+    }
+    warp = new WarpPerspective(createTransform(sources[selSource], corners));
+    mesh = warp.createMesh(this, sources[selSource], res);
+  }
 
-  // regenerate mesh if we're dragging a corner
+  // update the mesh if we're dragging a corner
   if (selCorner != -1 && (pmouseX != mouseX || pmouseY != mouseY)) {
     corners[selCorner].x = mouseX;
     corners[selCorner].y = mouseY;
-    // this improves performance, but will be replaced by a
-    // more elegant way in a future release
-    quads = null;
-    System.gc();
-    quads = createMesh(sources[selSource], corners, res);
+    // this only moves the vertices of the existing mesh
+    warp.setTransform(createTransform(sources[selSource], corners));
+    warp.updateMesh(mesh);
   }
 
   // display
-  if (quads != null) {
-    for (int i=0; i < quads.length; i++) {
-      shape(quads[i]);
-    }
-  }
+  shape(mesh);
 
   // hide the mouse cursor after two seconds
   if (pmouseX != mouseX || pmouseY != mouseY) {
@@ -82,47 +84,17 @@ void mousePressed() {
 
   // no corner? then switch texture
   selSource = (selSource+1) % sources.length;
-  quads = createMesh(sources[selSource], corners, res);
+  mesh = null;
 }
 
 void mouseReleased() {
   selCorner = -1;
 }
 
-PShape[] createMesh(PImage tex, PVector[] corners, int res) {
-  PerspectiveTransform transform = PerspectiveTransform.getQuadToQuad(
+PerspectiveTransform createTransform(PImage tex, PVector[] corners) {
+  return PerspectiveTransform.getQuadToQuad(
     0, 0, tex.width, 0,                   // top left, top right
     tex.width, tex.height, 0, tex.height, // bottom right, bottom left
-    corners[0].x, corners[0].y, corners[1].x, corners[1].y, 
+    corners[0].x, corners[0].y, corners[1].x, corners[1].y,
     corners[2].x, corners[2].y, corners[3].x, corners[3].y);
-
-  WarpPerspective warpPerspective = new WarpPerspective(transform);
-
-  float xStep = (float) tex.width / res;
-  float yStep = (float) tex.height / res;
-
-  PShape quads[] = new PShape[res*res];
-  for (int y=0; y < res; y++) {
-    for (int x=0; x < res; x++) {
-
-      textureMode(NORMAL);
-      PShape sh = createShape();
-      sh.beginShape(QUAD);
-      sh.noStroke();
-      sh.texture(tex);
-      sh.normal(0, 0, 1);
-      Point2D point = warpPerspective.mapDestPoint(x*xStep, y*yStep);
-      sh.vertex((float)point.getX(), (float)point.getY(), 0, (float)x / res, (float)y / res);
-      point = warpPerspective.mapDestPoint((x+1)*xStep, y*yStep);
-      sh.vertex((float)point.getX(), (float)point.getY(), 0, (float)(x+1) / res, (float)y / res);
-      point = warpPerspective.mapDestPoint((x+1)*xStep, (y+1)*yStep);
-      sh.vertex((float)point.getX(), (float)point.getY(), 0, (float)(x+1) / res, (float)(y+1) / res);
-      point = warpPerspective.mapDestPoint(x*xStep, (y+1)*yStep);
-      sh.vertex((float)point.getX(), (float)point.getY(), 0, (float)x / res, (float)(y+1) / res);
-      sh.endShape();
-
-      quads[y * res + x] = sh;
-    }
-  }
-  return quads;
-}
\ No newline at end of file
+}
@@ -0,0 +1,59 @@
+/**
+ *  Plays 16 videos as a video wall.
+ *  Instead of drawing every video by itself, the frames are copied into
+ *  a single texture atlas, which is then drawn as one shape.
+ *  With GLVideo.SCALABLE, the frames get scaled to the size of the tiles
+ *  on the GPU.
+ */
+
+import gohai.glvideo.*;
+
+int COLS = 4;
+int ROWS = 4;
+int TILE_W = 320;
+int TILE_H = 180;
+
+GLMovie[] videos = new GLMovie[COLS * ROWS];
+GLVideoAtlas atlas;
+PShape wall;
+
+void setup() {
+  size(1280, 720, P2D);
+  atlas = new GLVideoAtlas(this, COLS * TILE_W, ROWS * TILE_H);
+  for (int i=0; i < videos.length; i++) {
+    videos[i] = new GLMovie(this, "launch1.mp4", GLVideo.MUTE | GLVideo.SCALABLE);
+    videos[i].loop();
+    atlas.add(videos[i], (i % COLS) * TILE_W, (i / COLS) * TILE_H, TILE_W, TILE_H);
+  }
+
+  // one quad per tile, all sampling from the atlas
+  textureMode(IMAGE);
+  wall = createShape();
+  wall.beginShape(QUADS);
+  wall.noStroke();
+  wall.texture(atlas);
+  for (int i=0; i < videos.length; i++) {
+    int[] r = atlas.rect(i);
+    float x = (i % COLS) * width / COLS;
+    float y = (i / COLS) * height / ROWS;
+    float w = width / COLS;
+    float h = height / ROWS;
+    wall.vertex(x, y, r[0], r[1]);
+    wall.vertex(x + w, y, r[0] + r[2], r[1]);
+    wall.vertex(x + w, y + h, r[0] + r[2], r[1] + r[3]);
+    wall.vertex(x, y + h, r[0], r[1] + r[3]);
+  }
+  wall.endShape();
+}
+
+void draw() {
+  background(0);
+  atlas.update();
+  shape(wall);
+
+  if (frameCount % 120 == 0) {
+    long[] stats = atlas.stats();
+    println(stats[0] + " videos, " + stats[1] + " frames copied, " + stats[2] + " us avg, " + stats[3] + " us max, " + stats[4] + " fence waits");
+    println("atlas " + stats[5] / 1024 + " KB, textures held by the videos " + stats[6] / 1024 + " KB");
+  }
+}
@@ -23,6 +23,7 @@
 package gohai.glvideo;
 
 import processing.core.*;
+import java.lang.reflect.Method;
 import java.util.ArrayList;
 
 /**
@@ -31,6 +32,14 @@ import java.util.ArrayList;
 public class GLCapture extends GLVideo {
 
   protected static String[][] devices;
+  protected static ArrayList<GLCapture> captures = new ArrayList<GLCapture>();
+  protected static ArrayList<Object> deviceListeners = new ArrayList<Object>();
+
+  protected String deviceName;
+  protected String config;
+  protected boolean started = false;
+  protected volatile boolean disconnected = false;
+  protected volatile boolean reconnect = false;
 
   public GLCapture(PApplet parent) {
     super(parent, 0);
@@ -44,10 +53,7 @@ public class GLCapture extends GLVideo {
     }
 
     // this is using whatever config GStreamer hands us as the default
-    handle = gstreamer_openDevice(devices[0][0], "video/x-raw", 0);
-    if (handle == 0) {
-      throw new RuntimeException("Could not open capture device " + devices[0][0]);
-    }
+    open(devices[0][0], "video/x-raw");
   }
 
   public GLCapture(PApplet parent, String deviceName) {
@@ -61,11 +67,7 @@ public class GLCapture extends GLVideo {
       if (devices[i][0].equals(deviceName)) {
 
         // this is using whatever config GStreamer hands us as the default
-        handle = gstreamer_openDevice(devices[i][0], "video/x-raw", 0);
-        if (handle == 0) {
-          throw new RuntimeException("Could not open capture device " + devices[i][0]);
-        }
-
+        open(devices[i][0], "video/x-raw");
         return;
       }
     }
@@ -74,32 +76,174 @@ public class GLCapture extends GLVideo {
   }
 
   public GLCapture(PApplet parent, String deviceName, float fps) {
-    // XXX: this picks e.g. 640x480 for 25 fps
-    this(parent, deviceName, "video/x-raw, framerate=" + fpsToFramerate(fps));
+    this(parent, deviceName, negotiate(deviceName, 0, 0, fps));
   }
 
   public GLCapture(PApplet parent, String deviceName, int width, int height) {
-    // XXX: this picks e.g. 10 fps for 1280x720
-    this(parent, deviceName, "video/x-raw, width=" + width + ", height=" + height);
+    // this picks the highest framerate available at this size
+    this(parent, deviceName, negotiate(deviceName, width, height, 0));
   }
 
   public GLCapture(PApplet parent, String deviceName, int width, int height, float fps) {
-    this(parent, deviceName, "video/x-raw, width=" + width + ", height=" + height + ", framerate=" + fpsToFramerate(fps));
+    this(parent, deviceName, negotiate(deviceName, width, height, fps));
   }
 
   public GLCapture(PApplet parent, String deviceName, String config) {
     super(parent, 0);
+    open(deviceName, config);
+  }
+
+  /**
+   *  Picks between uncompressed frames and Motion JPEG, based on what the
+   *  device supports at the given size. Uncompressed frames are used if
+   *  they are available at the requested framerate, since they don't need
+   *  to be decoded. Otherwise whichever format reaches the higher framerate
+   *  is used, which for larger sizes is typically Motion JPEG.
+   */
+  protected static String negotiate(String deviceName, int width, int height, float fps) {
+    loadGStreamer();
+    String caps = gstreamer_negotiateDeviceCaps(deviceName, width, height, fps);
+    if (caps != null) {
+      return caps;
+    }
+
+    // device caps aren't known, e.g. on macOS
+    caps = "video/x-raw";
+    if (0 < width && 0 < height) {
+      caps += ", width=" + width + ", height=" + height;
+    }
+    if (0 < fps) {
+      caps += ", framerate=" + fpsToFramerate(fps);
+    }
+    return caps;
+  }
 
-    handle = gstreamer_openDevice(deviceName, config, 0);
+  /**
+   *  Returns the format the capture device was opened with.
+   *  This is video/x-raw for uncompressed frames, and image/jpeg for
+   *  Motion JPEG, followed by the size and framerate, if they were requested.
+   */
+  public String format() {
+    return config;
+  }
+
+  protected void open(String deviceName, String config) {
+    this.deviceName = deviceName;
+    this.config = config;
+
+    handle = gstreamer_openDevice(deviceName, config, flags);
     if (handle == 0) {
       throw new RuntimeException("Could not open capture device " + deviceName);
     }
+
+    synchronized (captures) {
+      captures.add(this);
+    }
+  }
+
+  /**
+   *  Returns whether there is a new frame waiting to be displayed.
+   *  If the capture device got unplugged and plugged back in, this
+   *  also re-opens it.
+   */
+  public boolean available() {
+    if (reconnect) {
+      reconnect();
+    }
+    return super.available();
+  }
+
+  protected void reconnect() {
+    reconnect = false;
+    disconnected = false;
+
+    if (handle != 0) {
+      releaseHandle();
+      gstreamer_close(handle);
+      handle = 0;
+    }
+    // the device is looked up in the cached device list, so this doesn't rescan
+    handle = gstreamer_openDevice(deviceName, config, flags);
+    if (handle == 0) {
+      System.err.println("Could not reopen capture device " + deviceName);
+      return;
+    }
+    if (started) {
+      gstreamer_startPlayback(handle);
+    }
+  }
+
+  public void play() {
+    started = true;
+    super.play();
+  }
+
+  public void pause() {
+    started = false;
+    super.pause();
+  }
+
+  public void close() {
+    synchronized (captures) {
+      captures.remove(this);
+    }
+    super.close();
+  }
+
+  /**
+   *  Calls the listener's deviceEvent(String deviceName, boolean added) method
+   *  whenever a capture device gets plugged in or removed. Typically you'd
+   *  pass "this" to have the method in your sketch called. Note that this
+   *  happens on a different thread than draw.
+   *  @param listener object implementing deviceEvent
+   */
+  public static void deviceEvents(Object listener) {
+    // make sure the library is loaded, and the device monitor is running
+    loadGStreamer();
+    gstreamer_getDevices();
+    synchronized (deviceListeners) {
+      deviceListeners.add(listener);
+    }
+  }
+
+  /**
+   *  Called from a GStreamer thread when a capture device got plugged in or removed.
+   */
+  protected static void deviceEvent(String deviceName, boolean added) {
+    // this only takes a snapshot of the device monitor's list
+    devices = gstreamer_getDevices();
+
+    synchronized (captures) {
+      for (GLCapture capture : captures) {
+        if (deviceName.equals(capture.deviceName)) {
+          if (!added) {
+            capture.disconnected = true;
+          } else if (capture.disconnected) {
+            // this is done on the next call to available
+            capture.reconnect = true;
+          }
+        }
+      }
+    }
+
+    synchronized (deviceListeners) {
+      for (Object listener : deviceListeners) {
+        try {
+          Method method = listener.getClass().getMethod("deviceEvent", String.class, boolean.class);
+          method.invoke(listener, deviceName, added);
+        } catch (NoSuchMethodException e) {
+          System.err.println("GLCapture: " + listener.getClass().getName() + " is missing a deviceEvent(String, boolean) method");
+        } catch (Exception e) {
+          e.printStackTrace();
+        }
+      }
+    }
   }
 
   public static String[] list() {
     // make sure the library is loaded
     loadGStreamer();
-    // re-fetch the devices list, even if we have it already
+    // this is a snapshot of the list kept up to date by the device monitor
     devices = gstreamer_getDevices();
 
     // XXX: is the device name guaranteed to be unique?
@@ -58,6 +58,10 @@ public class GLMovie extends GLVideo {
   }
 
   protected String filenameToUri(String fn) {
+    return filenameToUri(parent, fn);
+  }
+
+  protected static String filenameToUri(PApplet parent, String fn) {
     // get absolute path for fn
     // first, check Processing's dataPath
     File file = new File(parent.dataPath(fn));
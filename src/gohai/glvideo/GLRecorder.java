@@ -0,0 +1,194 @@
+/* -*- mode: java; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+  Copyright (c) The Processing Foundation 2016
+  Developed by Gottfried Haider
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+package gohai.glvideo;
+
+import processing.core.*;
+import processing.opengl.*;
+
+/**
+ *  @webref
+ */
+public class GLRecorder {
+
+  /* queue policies */
+  public static final int DROP = 0;
+  public static final int BLOCK = 1;
+
+  protected PApplet parent;
+  protected String fn;
+  protected String encoder;
+  protected int fps;
+  protected int queueFrames = 8;
+  protected int policy = DROP;
+  protected long handle = 0;
+  protected boolean recording = false;
+  // the thread Processing is drawing on, which has the GL context
+  protected Thread glThread;
+  protected boolean stopPending = false;
+
+  /**
+   *  Datatype for recording the sketch's output to a video file.
+   *  Frames are read back from the GPU asynchronously, and encoded
+   *  on a separate thread, so that recording interferes as little as
+   *  possible with the sketch's frame rate.
+   *  @param parent typically use "this"
+   *  @param fn filename of the video file to write, relative to the sketch folder
+   *  @param fps frame rate the sketch is running at
+   *  @param encoder GStreamer elements for encoding and muxing, e.g. "x264enc ! mp4mux"
+   */
+  public GLRecorder(PApplet parent, String fn, int fps, String encoder) {
+    this.parent = parent;
+    this.fn = parent.savePath(fn);
+    this.fps = fps;
+    this.encoder = encoder;
+
+    GLVideo.loadGStreamer();
+    parent.registerMethod("post", this);
+    parent.registerMethod("dispose", this);
+  }
+
+  public GLRecorder(PApplet parent, String fn, int fps) {
+    this(parent, fn, fps, defaultEncoder());
+  }
+
+  public GLRecorder(PApplet parent, String fn) {
+    this(parent, fn, 60);
+  }
+
+  protected static String defaultEncoder() {
+    if (PApplet.platform == PConstants.LINUX && "arm".equals(System.getProperty("os.arch"))) {
+      return "omxh264enc ! h264parse ! mp4mux";
+    } else {
+      // this works without a GPU
+      return "x264enc speed-preset=ultrafast tune=zerolatency ! mp4mux";
+    }
+  }
+
+  /**
+   *  Sets how many frames can be waiting to be encoded, and what should happen
+   *  if the encoder can't keep up. With GLRecorder.DROP, frames that don't fit
+   *  into the queue anymore get dropped, with GLRecorder.BLOCK the sketch waits
+   *  for the encoder. This needs to be called before start.
+   *  @param frames maximum number of frames waiting to be encoded
+   *  @param policy GLRecorder.DROP (default) or GLRecorder.BLOCK
+   */
+  public void queue(int frames, int policy) {
+    if (handle != 0) {
+      System.err.println("GLRecorder: queue needs to be called before start");
+      return;
+    }
+    this.queueFrames = frames;
+    this.policy = policy;
+  }
+
+  /**
+   *  Starts or resumes recording.
+   *  Every frame drawn after this is being added to the video file.
+   */
+  public void start() {
+    if (handle == 0) {
+      PGraphicsOpenGL pg = (PGraphicsOpenGL)parent.g;
+      handle = GLVideo.gstreamer_openRecorder(fn, encoder, pg.pixelWidth, pg.pixelHeight, fps, queueFrames, policy == BLOCK);
+      if (handle == 0) {
+        throw new RuntimeException("Could not start recording");
+      }
+    }
+    stopPending = false;
+    recording = true;
+  }
+
+  /**
+   *  Pauses recording.
+   *  Recording can be resumed with the start method.
+   */
+  public void pause() {
+    recording = false;
+  }
+
+  /**
+   *  Stops recording, and finishes writing the video file.
+   *  Call this before exiting the sketch, otherwise the file might not be playable.
+   *  When called from outside of Processing's drawing thread, the file
+   *  gets finished after the next frame has been drawn.
+   */
+  public void stop() {
+    recording = false;
+    if (handle == 0) {
+      return;
+    }
+    if (Thread.currentThread() == glThread) {
+      close(true);
+    } else {
+      stopPending = true;
+    }
+  }
+
+  protected void close(boolean onGlThread) {
+    stopPending = false;
+    if (handle != 0) {
+      GLVideo.gstreamer_closeRecorder(handle, onGlThread);
+      handle = 0;
+    }
+  }
+
+  /**
+   *  Returns whether the sketch is currently being recorded.
+   */
+  public boolean recording() {
+    return recording;
+  }
+
+  /**
+   *  Returns statistics about the recording.
+   *  The array contains the number of frames recorded, the number of frames
+   *  dropped, and the number of frames currently waiting to be encoded.
+   */
+  public long[] stats() {
+    if (handle == 0) {
+      return new long[3];
+    } else {
+      return GLVideo.gstreamer_getRecorderStats(handle);
+    }
+  }
+
+  /**
+   *  Called by Processing after the frame has been drawn.
+   *  This reads from the default framebuffer, since any multisampled FBO
+   *  has been resolved at this point.
+   */
+  public void post() {
+    glThread = Thread.currentThread();
+    if (stopPending) {
+      close(true);
+    } else if (recording && handle != 0) {
+      GLVideo.gstreamer_recorderAddFrame(handle);
+    }
+  }
+
+  public void dispose() {
+    recording = false;
+    // this might not be called on the GL thread, so the frames still being
+    // read back get dropped, but the file gets finished
+    close(Thread.currentThread() == glThread);
+  }
+}
@@ -0,0 +1,132 @@
+/* -*- mode: java; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+  Copyright (c) The Processing Foundation 2016
+  Developed by Gottfried Haider
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+package gohai.glvideo;
+
+import processing.core.*;
+
+/**
+ *  @webref
+ */
+public class GLThumbnailer {
+
+  protected PApplet parent;
+  protected int width;
+  protected int height;
+  protected boolean exact = false;
+  protected int threads;
+  protected int extracted = 0;
+  protected float throughput = 0.0f;
+
+  /**
+   *  Datatype for extracting thumbnails from many video files at once.
+   *  Each file is decoded by a single pipeline, which is scaled down to
+   *  the thumbnail size before the pixels are downloaded. Files are
+   *  processed in parallel by a pool of worker threads.
+   *  @param parent typically use "this"
+   *  @param width width of the thumbnails
+   *  @param height height of the thumbnails
+   */
+  public GLThumbnailer(PApplet parent, int width, int height) {
+    this.parent = parent;
+    this.width = width;
+    this.height = height;
+    this.threads = Runtime.getRuntime().availableProcessors();
+    GLVideo.loadGStreamer();
+  }
+
+  /**
+   *  Sets whether thumbnails are taken at the exact timestamps.
+   *  By default, the closest keyframe is used, which is a lot faster.
+   *  @param exact true to decode up to the exact timestamp
+   */
+  public void exact(boolean exact) {
+    this.exact = exact;
+  }
+
+  /**
+   *  Sets the number of files that are processed in parallel.
+   *  This defaults to the number of CPU cores.
+   *  @param threads number of worker threads
+   */
+  public void threads(int threads) {
+    this.threads = Math.max(threads, 1);
+  }
+
+  /**
+   *  Extracts thumbnails from a list of files.
+   *  Files are looked up in the data folder, unless they are URIs.
+   *  @param files filenames or URIs
+   *  @param times timestamps in seconds
+   *  @return thumbnails for each file and timestamp, or null where
+   *  a thumbnail couldn't be extracted
+   */
+  public PImage[][] extract(String[] files, float[] times) {
+    String[] uris = new String[files.length];
+    for (int i=0; i < files.length; i++) {
+      if (files[i].indexOf("://") != -1) {
+        uris[i] = files[i];
+      } else {
+        uris[i] = GLMovie.filenameToUri(parent, files[i]);
+      }
+    }
+
+    long start = System.nanoTime();
+    int[][] pixels = GLVideo.gstreamer_extractThumbnails(uris, times, width, height, exact, threads);
+    long elapsed = System.nanoTime() - start;
+
+    PImage[][] thumbnails = new PImage[files.length][times.length];
+    extracted = 0;
+    for (int i=0; i < files.length; i++) {
+      for (int j=0; j < times.length; j++) {
+        int[] p = pixels[i * times.length + j];
+        if (p == null) {
+          continue;
+        }
+        PImage img = parent.createImage(width, height, PConstants.RGB);
+        img.loadPixels();
+        System.arraycopy(p, 0, img.pixels, 0, p.length);
+        img.updatePixels();
+        thumbnails[i][j] = img;
+        extracted++;
+      }
+    }
+    throughput = (0 < elapsed) ? extracted / (elapsed / 1000000000.0f) : 0.0f;
+    return thumbnails;
+  }
+
+  /**
+   *  Returns the throughput of the last call to extract().
+   *  @return thumbnails per second
+   */
+  public float throughput() {
+    return throughput;
+  }
+
+  /**
+   *  Returns the number of thumbnails returned by the last call to extract().
+   *  @return number of thumbnails
+   */
+  public int extracted() {
+    return extracted;
+  }
+}
@@ -23,8 +23,18 @@
 package gohai.glvideo;
 
 import java.io.File;
+import java.lang.reflect.Field;
+import java.lang.reflect.Method;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.nio.file.Files;
 import java.nio.file.Paths;
+import java.security.MessageDigest;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Comparator;
+import java.util.HashMap;
+import java.util.LinkedHashMap;
 import processing.core.*;
 import processing.opengl.*;
 
@@ -36,15 +46,41 @@ public class GLVideo extends PImage {
   /* flags */
   public static final int MUTE = 1;
   public static final int NO_SYNC = 2;
+  public static final int DOWNLOAD = 4;
+  public static final int SCALABLE = 8;
+
+  /* layout of the native frame descriptor, see GLVIDEO_FRAME_DESC_T */
+  protected static final int DESC_SEQ = 0;
+  protected static final int DESC_TEX = 4;
+  protected static final int DESC_WIDTH = 8;
+  protected static final int DESC_HEIGHT = 12;
+  protected static final int DESC_PLAYING = 16;
+  protected static final int DESC_PTS = 24;
+  protected static final int DESC_POSITION = 32;
+  protected static final int DESC_DURATION = 40;
+  protected static final int DESC_FRAMES = 48;
+  protected static final int DESC_MISSED = 56;
 
   protected static boolean loaded = false;
   protected static boolean error = false;
+  protected static String[] pluginAllowlist;
+  protected static LinkedHashMap<String, Float> initTimes = new LinkedHashMap<String, Float>();
+  protected static HashMap<Long, GLVideo> cueVideos = new HashMap<Long, GLVideo>();
+  // for the load fences of the frame descriptor's seqlock, null if not available
+  protected static final sun.misc.Unsafe unsafe = getUnsafe();
 
   protected PApplet parent;
   protected long handle = 0;
   protected Texture texture;
   protected int flags = 0;
   protected boolean pixelsOutdated = true;
+  protected HashMap<Long, int[]> regionCache = new HashMap<Long, int[]>();
+  protected Method cueEventMethod;
+  // index of every cue, sorted by time, in the array passed to cues
+  protected volatile int[] cueOrder = new int[0];
+  protected HashMap<Integer, LinkedHashMap<String, String>> shaderUniforms = new HashMap<Integer, LinkedHashMap<String, String>>();
+  protected ByteBuffer desc;
+  protected boolean useDesc = false;
 
   /**
    *  Datatype for playing video files, which can be located in the sketch's
@@ -57,7 +93,9 @@ public class GLVideo extends PImage {
    */
 
   /**
-   *  @param flags pass GLVideo.MUTE to disable audio playback
+   *  @param flags pass GLVideo.MUTE to disable audio playback, GLVideo.DOWNLOAD to
+   *  buffer network streams in a ring buffer (see ringBufferSize), GLVideo.SCALABLE
+   *  to add a scaling pass on the GPU (see adaptiveQuality)
    */
 
   public GLVideo(PApplet parent, int flags) {
@@ -99,6 +137,139 @@ public class GLVideo extends PImage {
     }
   }
 
+  /**
+   *  Only load the plugins listed, rather than everything that is installed.
+   *  This also disables scanning for new or updated plugins, which can cut down
+   *  the time it takes to start up considerably. Plugins are given by their
+   *  name, e.g. "coreelements", "playback", "typefindfunctions", "isomp4",
+   *  "libav", "videoconvert", "opengl", or the full path to the plugin file.
+   *  This needs to be called before the first video is created.
+   *  @param plugins names of the plugins to load
+   */
+  public static void pluginAllowlist(String... plugins) {
+    if (loaded) {
+      System.err.println("GLVideo: pluginAllowlist needs to be called before any video is created");
+      return;
+    }
+    pluginAllowlist = plugins;
+  }
+
+  /**
+   *  Returns the time in milliseconds spent in the different phases of
+   *  loading and initializing GStreamer.
+   */
+  public static LinkedHashMap<String, Float> initTimes() {
+    return initTimes;
+  }
+
+  /**
+   *  Sets the number of GL contexts (and threads) that GStreamer's GL elements
+   *  are run on. Videos opened afterwards get distributed across those, rather
+   *  than each of them creating its own GL context and thread. Pass 0 to let
+   *  every video create its own context. The default is 1.
+   *  @param num number of shared GL contexts (0 to 8)
+   */
+  public static void sharedContexts(int num) {
+    loadNativeLibrary();
+    gstreamer_setSharedContexts(num);
+  }
+
+  /**
+   *  Limits the number of RGBA textures each video keeps around.
+   *  This proposes a fixed-size pool of textures to GStreamer, which makes
+   *  the GPU memory used per video predictable. At least three buffers
+   *  should be allowed, since up to two are held by the library itself.
+   *  This only affects videos opened afterwards, and requires shared
+   *  GL contexts (see sharedContexts). The default is to leave this
+   *  to GStreamer.
+   *  @param minBuffers number of textures to allocate upfront
+   *  @param maxBuffers maximum number of textures (0 to leave this to GStreamer)
+   */
+  public static void bufferPool(int minBuffers, int maxBuffers) {
+    loadNativeLibrary();
+    gstreamer_setBufferPool(minBuffers, maxBuffers);
+  }
+
+  /**
+   *  Sets the size of the ring buffer used for videos opened with the
+   *  DOWNLOAD flag. Pass 0 to download the entire stream to a temporary
+   *  file instead. The default is 32 MB.
+   *  This only affects videos opened afterwards.
+   *  @param bytes size of the ring buffer
+   */
+  public static void ringBufferSize(long bytes) {
+    loadNativeLibrary();
+    gstreamer_setRingBufferSize(bytes);
+  }
+
+  /**
+   *  Makes GStreamer pick the given decoders over all others.
+   *  The first decoder listed is preferred the most. This only affects
+   *  videos opened afterwards.
+   *  @param decoders names of decoder elements, e.g. "avdec_h264"
+   */
+  public static void preferDecoders(String... decoders) {
+    loadGStreamer();
+    for (int i=0; i < decoders.length; i++) {
+      // above GST_RANK_PRIMARY
+      if (!gstreamer_setDecoderRank(decoders[i], 256 + decoders.length - i)) {
+        System.err.println("GLVideo: Decoder " + decoders[i] + " not found");
+      }
+    }
+  }
+
+  /**
+   *  Prevents GStreamer from using the given decoders.
+   *  This only affects videos opened afterwards.
+   *  @param decoders names of decoder elements, e.g. "omxh264dec"
+   */
+  public static void blacklistDecoders(String... decoders) {
+    loadGStreamer();
+    for (int i=0; i < decoders.length; i++) {
+      // GST_RANK_NONE
+      gstreamer_setDecoderRank(decoders[i], 0);
+    }
+  }
+
+  /**
+   *  Sets the number of threads software decoders use.
+   *  This only affects videos opened afterwards. The default is to leave
+   *  this to the decoder, which often picks a value based on the number
+   *  of CPU cores.
+   *  @param threads number of threads (0 for the decoder's default)
+   */
+  public static void decoderThreads(int threads) {
+    loadNativeLibrary();
+    gstreamer_setDecoderThreads(threads);
+  }
+
+  /**
+   *  Sets how much compressed data is queued in front of the decoders.
+   *  Larger queues can smooth over variations in decoding time.
+   *  This only affects videos opened afterwards.
+   *  @param sec duration of data to queue (0 for GStreamer's default)
+   */
+  public static void decoderQueue(float sec) {
+    loadNativeLibrary();
+    gstreamer_setDecoderQueue((long)(sec * 1000000000L));
+  }
+
+  /**
+   *  Returns statistics about the resources used by the library, for
+   *  finding leaks and regressions in how long it takes to open videos.
+   *  The array contains the number of pipelines opened, closed and failed
+   *  to open, the number currently open, the average and maximum time
+   *  spent opening a pipeline (us), the average and maximum time until the
+   *  first frame arrived (us), the number of video textures held, the number
+   *  of other GL objects created by the library, and the resident memory
+   *  (bytes), open file descriptors and threads of the process. The last
+   *  three are -1 where they can't be determined.
+   */
+  public static long[] resourceStats() {
+    loadGStreamer();
+    return gstreamer_getResourceStats();
+  }
+
   /**
    *  Load the native glvideo library, setup the environment for GStreamer and initialize it
    *  through gstreamer_init
@@ -108,20 +279,28 @@ public class GLVideo extends PImage {
     boolean use_host_gstreamer = false;
 
     if (!loaded) {
+      long start = System.nanoTime();
       loadNativeLibrary();
       loaded = true;
+      initTimes.put("library", elapsedMillis(start));
 
+      start = System.nanoTime();
       String jar = GLVideo.class.getProtectionDomain().getCodeSource().getLocation().getPath();
       String nativeLib = jar.substring(0, jar.lastIndexOf(File.separatorChar));
+      // only set when using a bundled copy of GStreamer
+      String registry = null;
+      String[] pluginDirs = null;
 
       if (PApplet.platform == PConstants.LINUX) {
         if ("arm".equals(System.getProperty("os.arch"))) {
-          // set a custom plugin path and prevent globally installed libraries from being loaded
-          gstreamer_setEnvVar("GST_PLUGIN_SYSTEM_PATH_1_0", "");
           // the second plugin path is necessary since the directory structure for exported applications
           // doesn't contain a linux-armv6hf directory
-          gstreamer_setEnvVar("GST_PLUGIN_PATH_1_0", nativeLib + "/linux-armv6hf/gstreamer-1.0/:" + nativeLib + "/gstreamer-1.0/");
-          gstreamer_setEnvVar("GST_REGISTRY_1_0", nativeLib + "/linux-armv6hf/gstreamer-1.0/registry");
+          pluginDirs = new String[] { nativeLib + "/linux-armv6hf/gstreamer-1.0/", nativeLib + "/gstreamer-1.0/" };
+          registry = nativeLib + "/linux-armv6hf/gstreamer-1.0/registry";
+          // set a custom plugin path and prevent globally installed libraries from being loaded
+          gstreamer_setEnvVar("GST_PLUGIN_SYSTEM_PATH_1_0", "");
+          gstreamer_setEnvVar("GST_PLUGIN_PATH_1_0", pluginDirs[0] + ":" + pluginDirs[1]);
+          gstreamer_setEnvVar("GST_REGISTRY_1_0", registry);
           // keep a local registry
           gstreamer_setEnvVar("GST_REGISTRY_FORK", "no");
         } else {
@@ -129,9 +308,11 @@ public class GLVideo extends PImage {
           use_host_gstreamer = true;
         }
       } else if (PApplet.platform == PConstants.MACOSX) {
+        pluginDirs = new String[] { nativeLib + "/macosx/gstreamer-1.0/", nativeLib + "/gstreamer-1.0/" };
+        registry = nativeLib + "/macosx/gstreamer-1.0/registry";
         gstreamer_setEnvVar("GST_PLUGIN_SYSTEM_PATH_1_0", "");
-        gstreamer_setEnvVar("GST_PLUGIN_PATH_1_0", nativeLib + "/macosx/gstreamer-1.0/:" + nativeLib + "/gstreamer-1.0/");
-        gstreamer_setEnvVar("GST_REGISTRY_1_0", nativeLib + "/macosx/gstreamer-1.0/registry");
+        gstreamer_setEnvVar("GST_PLUGIN_PATH_1_0", pluginDirs[0] + ":" + pluginDirs[1]);
+        gstreamer_setEnvVar("GST_REGISTRY_1_0", registry);
         gstreamer_setEnvVar("GST_REGISTRY_FORK", "no");
       } else {
         throw new RuntimeException("Windows support is not implemented currently");
@@ -139,9 +320,46 @@ public class GLVideo extends PImage {
 
       // we could also set GST_GL_API & GST_GL_PLATFORM here
 
+      boolean registryValid = false;
+      if (pluginAllowlist != null) {
+        if (pluginDirs == null) {
+          pluginDirs = new String[] { gstreamer_getPluginDir() };
+        }
+        // don't scan any plugin directory, and keep a separate (empty) registry
+        // the allowed plugins get loaded explicitly after initializing
+        gstreamer_setEnvVar("GST_PLUGIN_SYSTEM_PATH_1_0", "");
+        gstreamer_setEnvVar("GST_PLUGIN_PATH_1_0", "");
+        if (registry != null) {
+          gstreamer_setEnvVar("GST_REGISTRY_1_0", registry + "-allowlist");
+        } else {
+          gstreamer_setEnvVar("GST_REGISTRY_1_0", System.getProperty("java.io.tmpdir") + File.separator + "glvideo-registry-allowlist");
+        }
+        gstreamer_setEnvVar("GST_REGISTRY_UPDATE", "no");
+      } else if (registry != null) {
+        // skip checking every plugin for changes if neither the registry nor the plugins changed
+        registryValid = registryChecksum(registry, pluginDirs).equals(readChecksum(registry));
+        if (registryValid) {
+          gstreamer_setEnvVar("GST_REGISTRY_UPDATE", "no");
+        }
+      }
+      initTimes.put("environment", elapsedMillis(start));
+
+      start = System.nanoTime();
       if (gstreamer_init() == false) {
         error = true;
       }
+      initTimes.put("init", elapsedMillis(start));
+
+      if (!error && pluginAllowlist != null) {
+        start = System.nanoTime();
+        if (!loadPlugins(pluginAllowlist, pluginDirs)) {
+          error = true;
+        }
+        initTimes.put("plugins", elapsedMillis(start));
+      } else if (!error && registry != null && !registryValid) {
+        // GStreamer updated the registry
+        writeChecksum(registry, registryChecksum(registry, pluginDirs));
+      }
     }
 
     if (error) {
@@ -152,6 +370,107 @@ public class GLVideo extends PImage {
     }
   }
 
+  protected static final String[] PLUGIN_EXTENSIONS = { ".so", ".dylib", ".dll" };
+
+  /**
+   *  Loads the given plugins, and returns false if none of them could be loaded.
+   */
+  protected static boolean loadPlugins(String[] plugins, String[] pluginDirs) {
+    ArrayList<String> fns = new ArrayList<String>();
+    for (String plugin : plugins) {
+      String fn = null;
+      if (plugin.indexOf(File.separatorChar) != -1) {
+        fn = plugin;
+      } else {
+        for (int i=0; i < pluginDirs.length * PLUGIN_EXTENSIONS.length && fn == null; i++) {
+          File file = new File(pluginDirs[i / PLUGIN_EXTENSIONS.length], "libgst" + plugin + PLUGIN_EXTENSIONS[i % PLUGIN_EXTENSIONS.length]);
+          if (file.isFile()) {
+            fn = file.getAbsolutePath();
+          }
+        }
+      }
+      if (fn == null) {
+        System.err.println("GLVideo: Cannot find plugin " + plugin);
+      } else {
+        fns.add(fn);
+      }
+    }
+    int loaded = gstreamer_loadPlugins(fns.toArray(new String[fns.size()]));
+    if (loaded < plugins.length) {
+      System.err.println("GLVideo: Loaded only " + loaded + " of " + plugins.length + " plugins");
+    }
+    return 0 < loaded || plugins.length == 0;
+  }
+
+  protected static boolean isPlugin(String fn) {
+    if (!fn.startsWith("libgst")) {
+      return false;
+    }
+    for (String ext : PLUGIN_EXTENSIONS) {
+      if (fn.endsWith(ext)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   *  Returns a checksum over the registry file, and the names, sizes and
+   *  modification times of all plugins.
+   *  Other files are left out, since the registry and its checksum live
+   *  in the same directory, and get rewritten after this is calculated.
+   */
+  protected static String registryChecksum(String registry, String[] pluginDirs) {
+    try {
+      MessageDigest md = MessageDigest.getInstance("SHA-1");
+      File file = new File(registry);
+      if (!file.isFile()) {
+        return "";
+      }
+      md.update(Files.readAllBytes(file.toPath()));
+      for (String dir : pluginDirs) {
+        File[] plugins = new File(dir).listFiles();
+        if (plugins == null) {
+          continue;
+        }
+        Arrays.sort(plugins);
+        for (File plugin : plugins) {
+          if (!isPlugin(plugin.getName())) {
+            continue;
+          }
+          md.update((plugin.getName() + ":" + plugin.length() + ":" + plugin.lastModified() + "\n").getBytes("UTF-8"));
+        }
+      }
+      StringBuilder sb = new StringBuilder();
+      for (byte b : md.digest()) {
+        sb.append(String.format("%02x", b));
+      }
+      return sb.toString();
+    } catch (Exception e) {
+      return "";
+    }
+  }
+
+  protected static String readChecksum(String registry) {
+    try {
+      return new String(Files.readAllBytes(Paths.get(registry + ".sha1")), "UTF-8").trim();
+    } catch (Exception e) {
+      return null;
+    }
+  }
+
+  protected static void writeChecksum(String registry, String checksum) {
+    try {
+      Files.write(Paths.get(registry + ".sha1"), checksum.getBytes("UTF-8"));
+    } catch (Exception e) {
+      System.err.println("GLVideo: Error writing registry checksum");
+    }
+  }
+
+  protected static float elapsedMillis(long start) {
+    return (System.nanoTime() - start) / 1000000.0f;
+  }
+
   protected static void loadNativeLibrary() {
     // Raspbian August 2017 renamed libraries gstgl depends on
     workaroundBrcm();
@@ -196,6 +515,8 @@ public class GLVideo extends PImage {
   public boolean available() {
     if (handle == 0) {
       return false;
+    } else if (descriptor() != null) {
+      return descInt(DESC_TEX) != 0;
     } else {
       return gstreamer_isAvailable(handle);
     }
@@ -210,11 +531,12 @@ public class GLVideo extends PImage {
   public void read() {
     if (handle != 0) {
       // get current texture name
-      int texId = gstreamer_getFrame(handle);
+      // the frame count lets adaptive quality tell how many frames the sketch could read
+      int texId = gstreamer_getFrame(handle, parent.frameCount);
       // allocate Texture if needed, or simply update the texture name
       if (texture == null) {
-        int w = gstreamer_getWidth(handle);
-        int h = gstreamer_getHeight(handle);
+        int w = width();
+        int h = height();
         PGraphicsOpenGL pg = (PGraphicsOpenGL)parent.g;
         Texture.Parameters params = new Texture.Parameters(ARGB, POINT, false, CLAMP);
         texture = new Texture(pg, w, h, params);
@@ -229,6 +551,7 @@ public class GLVideo extends PImage {
       } else {
         texture.glName = texId;
         pixelsOutdated = true;
+        regionCache.clear();
       }
     }
   }
@@ -261,10 +584,14 @@ public class GLVideo extends PImage {
 
   /**
    *  Returns true if the video is playing or if playback got interrupted by buffering.
+   *  With the frame descriptor enabled, this is whether playback was requested
+   *  through play or loop, rather than the state of the pipeline.
    */
   public boolean playing() {
     if (handle == 0) {
       return false;
+    } else if (descriptor() != null) {
+      return descInt(DESC_PLAYING) != 0;
     } else {
       return gstreamer_isPlaying(handle);
     }
@@ -291,6 +618,37 @@ public class GLVideo extends PImage {
     }
   }
 
+  /**
+   *  Steps a number of frames forward or backward.
+   *  This pauses the video, and reads the frame that was stepped to, so
+   *  that every call results in exactly one new frame. Stepping forward
+   *  only decodes the frames in between, while stepping backward decodes
+   *  from the closest keyframe before the frame.
+   *  @param frames number of frames to step (negative to step backward)
+   *  @return timestamp of the new frame in seconds, or -1 if there is none
+   */
+  public float step(int frames) {
+    if (handle == 0) {
+      return -1.0f;
+    }
+    long pts = gstreamer_step(handle, frames);
+    if (pts < 0) {
+      return -1.0f;
+    }
+    if (frames != 0) {
+      read();
+    }
+    return pts / 1000000000.0f;
+  }
+
+  /**
+   *  Steps to the next frame.
+   *  @return timestamp of the new frame in seconds, or -1 if there is none
+   */
+  public float step() {
+    return step(1);
+  }
+
   /**
    *  Changes the speed in which a video file plays.
    *  Values larger than 1.0 will play the video faster than real time,
@@ -334,20 +692,33 @@ public class GLVideo extends PImage {
   public float duration() {
     if (handle == 0) {
       return 0.0f;
-    } else {
-      return gstreamer_getDuration(handle);
     }
+    if (descriptor() != null) {
+      long duration = descLong(DESC_DURATION);
+      if (0 <= duration) {
+        return duration / 1000000000.0f;
+      }
+    }
+    return gstreamer_getDuration(handle);
   }
 
   /**
    *  Returns the current time position in seconds.
+   *  With the frame descriptor enabled, this is the time of the most recent
+   *  frame delivered by the pipeline, which lags behind right after jump.
    */
   public float time() {
     if (handle == 0) {
       return 0.0f;
-    } else {
-      return gstreamer_getPosition(handle);
     }
+    if (descriptor() != null) {
+      // this is the time of the most recent frame
+      long position = descLong(DESC_POSITION);
+      if (0 <= position) {
+        return position / 1000000000.0f;
+      }
+    }
+    return gstreamer_getPosition(handle);
   }
 
   /**
@@ -356,9 +727,15 @@ public class GLVideo extends PImage {
   public int width() {
     if (handle == 0) {
       return 0;
-    } else {
-      return gstreamer_getWidth(handle);
     }
+    if (descriptor() != null) {
+      int width = descInt(DESC_WIDTH);
+      if (0 < width) {
+        return width;
+      }
+    }
+    // this waits until the size is known
+    return gstreamer_getWidth(handle);
   }
 
   /**
@@ -367,9 +744,15 @@ public class GLVideo extends PImage {
   public int height() {
     if (handle == 0) {
       return 0;
-    } else {
-      return gstreamer_getHeight(handle);
     }
+    if (descriptor() != null) {
+      int height = descInt(DESC_HEIGHT);
+      if (0 < height) {
+        return height;
+      }
+    }
+    // this waits until the size is known
+    return gstreamer_getHeight(handle);
   }
 
   /**
@@ -384,6 +767,306 @@ public class GLVideo extends PImage {
     }
   }
 
+  /**
+   *  Sets when playback of network streams gets paused for buffering.
+   *  Playback is paused once the buffer fill level drops below the low
+   *  watermark, and only resumed once it is back up to the high watermark.
+   *  The default is 10 and 100.
+   *  @param low low watermark in percent
+   *  @param high high watermark in percent
+   */
+  public void bufferingWatermarks(int low, int high) {
+    if (handle != 0) {
+      gstreamer_setBufferingWatermarks(handle, low, high);
+    }
+  }
+
+  /**
+   *  Returns statistics about buffering network streams.
+   *  The array contains the current buffer fill level (percent), the number
+   *  of times playback got paused for buffering, the total time spent
+   *  buffering (ms), the average input and output rates (bytes per second),
+   *  and the estimated time left until buffering is complete (ms).
+   */
+  public long[] bufferingStats() {
+    if (handle == 0) {
+      return new long[6];
+    } else {
+      return gstreamer_getBufferingStats(handle);
+    }
+  }
+
+  /**
+   *  Returns the approximate GPU memory in bytes used by the video's RGBA textures.
+   *  This counts the distinct textures handed to the library since the
+   *  video's size was last negotiated.
+   */
+  public long textureMemory() {
+    if (handle == 0) {
+      return 0;
+    } else {
+      return gstreamer_getTextureMemory(handle);
+    }
+  }
+
+  /**
+   *  Adapts the video's quality when the sketch can't keep up with it.
+   *  When frames are dropped, or take too long to be read, the resolution
+   *  is halved first. After that, movies only decode reference frames and
+   *  then keyframes, while capture devices lower their framerate. Quality is
+   *  raised again step by step once there is enough headroom.
+   *  Frames that arrive faster than the sketch's frame rate don't count as
+   *  dropped. The resolution is only lowered for videos opened with the
+   *  GLVideo.SCALABLE flag, since this needs an additional pass on the GPU.
+   *  @param enabled true to enable, false to go back to full quality
+   */
+  public void adaptiveQuality(boolean enabled) {
+    if (handle != 0) {
+      gstreamer_setAdaptive(handle, enabled);
+    }
+  }
+
+  /**
+   *  Returns statistics about the adaptive quality controller.
+   *  The array contains the current quality level (0 is full quality, 3 the
+   *  lowest), the number of times quality was stepped down and up, the number
+   *  of frames the sketch didn't get to read, the number of frames dropped by
+   *  the pipeline, the average time frames waited to be read (us) and the
+   *  maximum lateness of the pipeline (us).
+   */
+  public long[] adaptiveStats() {
+    if (handle == 0) {
+      return new long[7];
+    } else {
+      return gstreamer_getAdaptiveStats(handle);
+    }
+  }
+
+  /**
+   *  Calls the sketch's cueEvent(GLVideo video, int cue, float time) method
+   *  at the given times of the video, also when looping. The cue is the
+   *  index into the times as passed to this method, and time the cue's
+   *  time in the video in seconds. Cues are fired on the pipeline clock, independent
+   *  of the sketch's frame rate. Note that this happens on a different
+   *  thread than draw.
+   *  @param times times in seconds
+   */
+  public void cues(float... times) {
+    if (handle == 0) {
+      return;
+    }
+    try {
+      cueEventMethod = parent.getClass().getMethod("cueEvent", GLVideo.class, int.class, float.class);
+    } catch (NoSuchMethodException e) {
+      System.err.println("GLVideo: " + parent.getClass().getName() + " is missing a cueEvent(GLVideo, int, float) method");
+      return;
+    }
+    synchronized (cueVideos) {
+      cueVideos.put(handle, this);
+    }
+
+    // the native side wants the times sorted
+    Integer[] order = new Integer[times.length];
+    for (int i=0; i < times.length; i++) {
+      order[i] = i;
+    }
+    final float[] unsorted = times;
+    Arrays.sort(order, new Comparator<Integer>() {
+      public int compare(Integer a, Integer b) {
+        return Float.compare(unsorted[a], unsorted[b]);
+      }
+    });
+    float[] sorted = new float[times.length];
+    int[] cueOrder = new int[times.length];
+    for (int i=0; i < times.length; i++) {
+      sorted[i] = times[order[i]];
+      cueOrder[i] = order[i];
+    }
+    this.cueOrder = cueOrder;
+    gstreamer_setCues(handle, sorted);
+  }
+
+  /**
+   *  Called from the pipeline clock's thread when a cue is due.
+   */
+  protected static void cueEvent(long handle, int cue, long streamTime) {
+    GLVideo video;
+    synchronized (cueVideos) {
+      video = cueVideos.get(handle);
+    }
+    if (video == null) {
+      // closed in the meantime
+      return;
+    }
+    int[] cueOrder = video.cueOrder;
+    if (cueOrder.length <= cue) {
+      // from before cues got called again
+      return;
+    }
+    try {
+      video.cueEventMethod.invoke(video.parent, video, cueOrder[cue], streamTime / 1000000000.0f);
+    } catch (Exception e) {
+      e.printStackTrace();
+    }
+  }
+
+  /**
+   *  Adds a fragment shader that is applied to every frame inside the
+   *  GStreamer pipeline, before the sketch gets to read it. This runs on
+   *  GStreamer's GL thread, so that the cost of the effect overlaps with the
+   *  sketch's own rendering. Shaders follow the conventions of the glshader
+   *  element: the frame is the sampler2D "tex", the texture coordinate the
+   *  varying vec2 "v_texcoord", and the uniforms "time", "width" and "height"
+   *  are set automatically. Shaders added later are applied after the ones
+   *  added earlier.
+   *  @param filename fragment shader in the data folder
+   *  @return index of the shader, or -1 on error
+   */
+  public int addShader(String filename) {
+    if (handle == 0) {
+      return -1;
+    }
+    String[] lines = parent.loadStrings(filename);
+    if (lines == null) {
+      return -1;
+    }
+    return gstreamer_addShader(handle, PApplet.join(lines, "\n"));
+  }
+
+  /**
+   *  Sets a float uniform of a shader added with addShader.
+   *  @param shader index returned by addShader
+   *  @param name name of the uniform
+   *  @param value new value
+   */
+  public void uniform(int shader, String name, float value) {
+    setUniform(shader, name, "(float)" + value);
+  }
+
+  /**
+   *  Sets an int uniform of a shader added with addShader.
+   *  @param shader index returned by addShader
+   *  @param name name of the uniform
+   *  @param value new value
+   */
+  public void uniform(int shader, String name, int value) {
+    setUniform(shader, name, "(int)" + value);
+  }
+
+  protected void setUniform(int shader, String name, String value) {
+    if (handle == 0) {
+      return;
+    }
+    LinkedHashMap<String, String> uniforms = shaderUniforms.get(shader);
+    if (uniforms == null) {
+      uniforms = new LinkedHashMap<String, String>();
+      shaderUniforms.put(shader, uniforms);
+    }
+    uniforms.put(name, value);
+
+    // glshader takes all uniforms at once, as a GstStructure
+    StringBuilder str = new StringBuilder("uniforms");
+    for (String key : uniforms.keySet()) {
+      str.append(", ").append(key).append("=").append(uniforms.get(key));
+    }
+    gstreamer_setShaderUniforms(handle, shader, str.toString());
+  }
+
+  /**
+   *  Removes a shader added with addShader.
+   *  The indices of other shaders stay the same.
+   *  @param shader index returned by addShader
+   */
+  public void removeShader(int shader) {
+    if (handle != 0) {
+      shaderUniforms.remove(shader);
+      gstreamer_removeShader(handle, shader);
+    }
+  }
+
+  /**
+   *  Analyzes every frame natively, before it is uploaded to the GPU.
+   *  This computes a histogram of the brightness, a grid of how much the
+   *  brightness changed since the previous frame, and the area that changed.
+   *  This happens on GStreamer's streaming thread, so reading the results
+   *  costs next to nothing in draw. Only works for frames that are decoded
+   *  in software or come from a capture device as YUV.
+   *  @param gridWidth number of cells horizontally (up to 256)
+   *  @param gridHeight number of cells vertically (up to 256)
+   *  @param threshold change in brightness (0-255) for a cell to count as motion
+   */
+  public void frameAnalysis(int gridWidth, int gridHeight, int threshold) {
+    if (handle != 0) {
+      gridWidth = PApplet.constrain(gridWidth, 0, 256);
+      gridHeight = PApplet.constrain(gridHeight, 0, 256);
+      gstreamer_setAnalysis(handle, gridWidth, gridHeight, threshold);
+    }
+  }
+
+  /**
+   *  Enables or disables the frame analysis, with a grid of 32x24 cells.
+   *  @param enabled true to enable
+   */
+  public void frameAnalysis(boolean enabled) {
+    if (enabled) {
+      frameAnalysis(32, 24, 24);
+    } else {
+      frameAnalysis(0, 0, 0);
+    }
+  }
+
+  /**
+   *  Returns the brightness histogram of the most recent frame.
+   *  Only every other row of pixels is counted.
+   *  @return 256 bins
+   */
+  public int[] histogram() {
+    if (handle == 0) {
+      return new int[256];
+    } else {
+      return gstreamer_getHistogram(handle);
+    }
+  }
+
+  /**
+   *  Returns how much the brightness of each cell changed between the two
+   *  most recent frames, row by row.
+   *  @return values between 0 and 255
+   */
+  public int[] difference() {
+    if (handle == 0) {
+      return new int[0];
+    } else {
+      return gstreamer_getDifference(handle);
+    }
+  }
+
+  /**
+   *  Returns the area that changed between the two most recent frames.
+   *  The array contains x, y, width and height in pixels, which are all zero
+   *  if nothing changed, the number of cells that changed, and the number of
+   *  frames analyzed so far.
+   */
+  public int[] motion() {
+    if (handle == 0) {
+      return new int[6];
+    } else {
+      return gstreamer_getMotion(handle);
+    }
+  }
+
+  /**
+   *  Returns the name of the decoder GStreamer picked for the video.
+   *  @return name of the decoder element, or null if there is none
+   */
+  public String decoder() {
+    if (handle == 0) {
+      return null;
+    } else {
+      return gstreamer_getDecoder(handle);
+    }
+  }
+
   /**
    *  Closes a movie file.
    *  This method releases all resources associated with the playback of a movie file.
@@ -392,13 +1075,187 @@ public class GLVideo extends PImage {
    */
   public void close() {
     if (handle != 0) {
+      releaseHandle();
       gstreamer_close(handle);
       handle = 0;
     }
   }
 
+  /**
+   *  Drops everything on the Java side that belongs to the current native
+   *  handle. Call this before the handle gets closed.
+   */
+  protected void releaseHandle() {
+    synchronized (cueVideos) {
+      cueVideos.remove(handle);
+    }
+    // this memory is freed by gstreamer_close
+    desc = null;
+    regionCache.clear();
+    shaderUniforms.clear();
+    // the texture name belongs to the old pipeline
+    texture = null;
+    pixelsOutdated = true;
+  }
+
+  /**
+   *  Sets whether the state of the video is read from memory shared with
+   *  the native library, rather than through separate calls for available,
+   *  width, height, time, duration and playing. This is off by default.
+   *  Note that playing then returns whether playback was requested, and
+   *  time the timestamp of the most recent frame, rather than querying the
+   *  pipeline. This needs a JVM that provides memory fences, otherwise the
+   *  separate calls are used regardless.
+   *  @param enabled true to use the shared frame descriptor
+   */
+  public void frameDescriptor(boolean enabled) {
+    useDesc = enabled;
+    if (!enabled) {
+      desc = null;
+    }
+  }
+
+  protected static sun.misc.Unsafe getUnsafe() {
+    try {
+      Field field = sun.misc.Unsafe.class.getDeclaredField("theUnsafe");
+      field.setAccessible(true);
+      return (sun.misc.Unsafe) field.get(null);
+    } catch (Throwable e) {
+      return null;
+    }
+  }
+
+  protected ByteBuffer descriptor() {
+    if (desc == null && useDesc && unsafe != null && handle != 0) {
+      desc = gstreamer_getFrameDescriptor(handle).order(ByteOrder.nativeOrder());
+    }
+    return desc;
+  }
+
+  protected int descInt(int offset) {
+    // the native side increments seq before and after updating the descriptor
+    while (true) {
+      int seq = desc.getInt(DESC_SEQ);
+      if ((seq & 1) != 0) {
+        // being written
+        Thread.yield();
+        continue;
+      }
+      // keep the loads from being reordered across the reads of seq
+      unsafe.loadFence();
+      int val = desc.getInt(offset);
+      unsafe.loadFence();
+      if (seq == desc.getInt(DESC_SEQ)) {
+        return val;
+      }
+    }
+  }
+
+  protected long descLong(int offset) {
+    while (true) {
+      int seq = desc.getInt(DESC_SEQ);
+      if ((seq & 1) != 0) {
+        Thread.yield();
+        continue;
+      }
+      unsafe.loadFence();
+      long val = desc.getLong(offset);
+      unsafe.loadFence();
+      if (seq == desc.getInt(DESC_SEQ)) {
+        return val;
+      }
+    }
+  }
+
+  /**
+   *  Reads back a number of rectangular regions of the current frame.
+   *  Only the requested pixels are transferred from the GPU, which is a
+   *  lot faster than loadPixels when sampling small parts of large videos.
+   *  Regions are cached until the next frame is read. Regions reaching
+   *  outside of the frame get clipped, so their pixels might be fewer
+   *  than width times height.
+   *  @param rects x, y, width and height of each region
+   *  @return ARGB pixels of each region, or null if there is no frame yet
+   */
+  public int[][] getRegions(int[] rects) {
+    if (rects.length % 4 != 0) {
+      throw new IllegalArgumentException("rects needs to hold x, y, width and height of each region");
+    }
+    int num = rects.length / 4;
+    int[][] regions = new int[num][];
+
+    // clip to the frame, so that the native side doesn't read outside of it
+    rects = rects.clone();
+    for (int i=0; i < num; i++) {
+      if (rects[i*4+2] < 0 || rects[i*4+3] < 0) {
+        throw new IllegalArgumentException("Width and height can't be negative");
+      }
+      int x1 = Math.min(Math.max(rects[i*4], 0), width);
+      int y1 = Math.min(Math.max(rects[i*4+1], 0), height);
+      int x2 = Math.min(Math.max(rects[i*4] + rects[i*4+2], 0), width);
+      int y2 = Math.min(Math.max(rects[i*4+1] + rects[i*4+3], 0), height);
+      rects[i*4] = x1;
+      rects[i*4+1] = y1;
+      rects[i*4+2] = Math.max(x2 - x1, 0);
+      rects[i*4+3] = Math.max(y2 - y1, 0);
+    }
+
+    // fetch all regions that aren't cached in a single batch
+    int misses = 0;
+    for (int i=0; i < num; i++) {
+      regions[i] = regionCache.get(regionKey(rects, i));
+      if (regions[i] == null) {
+        misses++;
+      }
+    }
+    if (misses == 0 || handle == 0) {
+      return regions;
+    }
+    int[] missing = new int[misses * 4];
+    int j = 0;
+    for (int i=0; i < num; i++) {
+      if (regions[i] == null) {
+        System.arraycopy(rects, i * 4, missing, j * 4, 4);
+        j++;
+      }
+    }
+    int[] pixels = gstreamer_getRegions(handle, missing);
+    if (pixels == null) {
+      return regions;
+    }
+
+    int off = 0;
+    for (int i=0; i < num; i++) {
+      if (regions[i] == null) {
+        int len = rects[i*4+2] * rects[i*4+3];
+        regions[i] = Arrays.copyOfRange(pixels, off, off + len);
+        regionCache.put(regionKey(rects, i), regions[i]);
+        off += len;
+      }
+    }
+    return regions;
+  }
+
+  protected static long regionKey(int[] rects, int i) {
+    return ((long)(rects[i*4] & 0xffff) << 48) | ((long)(rects[i*4+1] & 0xffff) << 32) |
+           ((long)(rects[i*4+2] & 0xffff) << 16) | (long)(rects[i*4+3] & 0xffff);
+  }
+
+  protected boolean regionInside(int x, int y, int w, int h) {
+    return (texture != null && 0 <= x && 0 <= y && 0 < w && 0 < h &&
+            x + w <= width && y + h <= height);
+  }
+
   public int get(int x, int y) {
     if (pixelsOutdated) {
+      // read back just this pixel
+      if (!regionInside(x, y, 1, 1)) {
+        return 0;
+      }
+      int[][] regions = getRegions(new int[] { x, y, 1, 1 });
+      if (regions[0] != null) {
+        return regions[0][0];
+      }
       loadPixels();
     }
     return super.get(x, y);
@@ -406,6 +1263,16 @@ public class GLVideo extends PImage {
 
   public PImage get(int x, int y, int w, int h) {
     if (pixelsOutdated) {
+      if (regionInside(x, y, w, h)) {
+        int[][] regions = getRegions(new int[] { x, y, w, h });
+        if (regions[0] != null) {
+          PImage img = parent.createImage(w, h, ARGB);
+          img.loadPixels();
+          System.arraycopy(regions[0], 0, img.pixels, 0, w * h);
+          img.updatePixels();
+          return img;
+        }
+      }
       loadPixels();
     }
     return super.get(x, y, w, h);
@@ -430,17 +1297,28 @@ public class GLVideo extends PImage {
 
   public static native void gstreamer_setEnvVar(String name, String val);
   public static native boolean gstreamer_init();
+  public static native void gstreamer_setSharedContexts(int num);
+  public static native void gstreamer_setBufferPool(int minBuffers, int maxBuffers);
+  public static native void gstreamer_setRingBufferSize(long bytes);
+  public static native boolean gstreamer_setDecoderRank(String name, int rank);
+  public static native void gstreamer_setDecoderThreads(int threads);
+  public static native void gstreamer_setDecoderQueue(long time);
+  public static native String gstreamer_getPluginDir();
+  public static native int gstreamer_loadPlugins(String[] fns);
   public static native String gstreamer_filenameToUri(String fn);
   public static native String[][] gstreamer_getDevices();
+  public static native String gstreamer_negotiateDeviceCaps(String deviceName, int width, int height, float fps);
+  public static native long[] gstreamer_getResourceStats();
   public static native long gstreamer_openPipeline(String pipeline, int flags);
   public static native long gstreamer_openDevice(String deviceName, String caps, int flags);
   public static native boolean gstreamer_isAvailable(long handle);
-  public static native int gstreamer_getFrame(long handle);
+  public static native int gstreamer_getFrame(long handle, int sketchFrame);
   public static native void gstreamer_startPlayback(long handle);
   public static native boolean gstreamer_isPlaying(long handle);
   public static native void gstreamer_stopPlayback(long handle);
   public static native void gstreamer_setLooping(long handle, boolean looping);
   public static native boolean gstreamer_seek(long handle, float sec);
+  public static native long gstreamer_step(long handle, int frames);
   public static native boolean gstreamer_setSpeed(long handle, float rate);
   public static native boolean gstreamer_setVolume(long handle, float vol);
   public static native float gstreamer_getDuration(long handle);
@@ -448,5 +1326,32 @@ public class GLVideo extends PImage {
   public static native int gstreamer_getWidth(long handle);
   public static native int gstreamer_getHeight(long handle);
   public static native float gstreamer_getFramerate(long handle);
+  public static native void gstreamer_setBufferingWatermarks(long handle, int low, int high);
+  public static native long[] gstreamer_getBufferingStats(long handle);
+  public static native long gstreamer_getTextureMemory(long handle);
+  public static native int[] gstreamer_getRegions(long handle, int[] rects);
+  public static native void gstreamer_setAdaptive(long handle, boolean enabled);
+  public static native long[] gstreamer_getAdaptiveStats(long handle);
+  public static native void gstreamer_setCues(long handle, float[] times);
+  public static native int gstreamer_addShader(long handle, String fragment);
+  public static native boolean gstreamer_setShaderUniforms(long handle, int shader, String uniforms);
+  public static native void gstreamer_removeShader(long handle, int shader);
+  public static native void gstreamer_setAnalysis(long handle, int gridWidth, int gridHeight, int threshold);
+  public static native int[] gstreamer_getHistogram(long handle);
+  public static native int[] gstreamer_getDifference(long handle);
+  public static native int[] gstreamer_getMotion(long handle);
+  public static native ByteBuffer gstreamer_getFrameDescriptor(long handle);
+  public static native String gstreamer_getDecoder(long handle);
   public static native void gstreamer_close(long handle);
+  public static native long gstreamer_openRecorder(String fn, String encoder, int width, int height, int fps, int maxFrames, boolean block);
+  public static native void gstreamer_recorderAddFrame(long handle);
+  public static native long[] gstreamer_getRecorderStats(long handle);
+  public static native void gstreamer_closeRecorder(long handle, boolean glThread);
+  public static native int[][] gstreamer_extractThumbnails(String[] uris, float[] times, int width, int height, boolean exact, int threads);
+  public static native void gstreamer_warpPoints(float[] mat, float[] src, float[] dst, int count);
+  public static native long gstreamer_openAtlas(int width, int height);
+  public static native boolean gstreamer_addToAtlas(long handle, long video, int x, int y, int width, int height);
+  public static native int gstreamer_updateAtlas(long handle);
+  public static native long[] gstreamer_getAtlasStats(long handle);
+  public static native void gstreamer_closeAtlas(long handle);
 }
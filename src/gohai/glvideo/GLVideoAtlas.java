@@ -0,0 +1,213 @@
+/* -*- mode: java; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+  Copyright (c) The Processing Foundation 2016
+  Developed by Gottfried Haider
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+package gohai.glvideo;
+
+import java.util.ArrayList;
+import processing.core.*;
+import processing.opengl.*;
+
+/**
+ *  @webref
+ */
+public class GLVideoAtlas extends PImage {
+
+  protected PApplet parent;
+  protected long handle = 0;
+  protected Texture texture;
+  protected ArrayList<GLVideo> videos = new ArrayList<GLVideo>();
+  protected ArrayList<int[]> rects = new ArrayList<int[]>();
+  // for placing videos automatically, row by row
+  protected int rowX = 0;
+  protected int rowY = 0;
+  protected int rowHeight = 0;
+  protected long updates = 0;
+
+  /**
+   *  Datatype for compositing many videos into a single texture.
+   *  Every new frame of a video is copied into its rectangle of the atlas
+   *  on GStreamer's GL thread as soon as it has been decoded, so that the
+   *  videos don't need to hold on to textures for the sketch. The whole
+   *  atlas can then be drawn with a single texture, e.g. in one PShape,
+   *  rather than binding and drawing every video by itself.
+   *  Videos opened with the GLVideo.SCALABLE flag are scaled to their
+   *  rectangle on the GPU, others get cropped.
+   *  @param parent typically use "this"
+   *  @param width width of the atlas in pixels
+   *  @param height height of the atlas in pixels
+   */
+  public GLVideoAtlas(PApplet parent, int width, int height) {
+    this.parent = parent;
+    // like PImage.init(), but without allocating the pixels array
+    this.width = width;
+    this.height = height;
+    this.format = ARGB;
+    this.pixelDensity = 1;
+    this.pixelWidth = width;
+    this.pixelHeight = height;
+
+    GLVideo.loadGStreamer();
+    handle = GLVideo.gstreamer_openAtlas(width, height);
+    parent.registerMethod("dispose", this);
+  }
+
+  /**
+   *  Adds a video to the next free spot of the atlas, at its native size.
+   *  @param video video to add
+   *  @return index of the video's rectangle
+   */
+  public int add(GLVideo video) {
+    int w = video.width();
+    int h = video.height();
+    if (width < rowX + w) {
+      // next row
+      rowX = 0;
+      rowY += rowHeight;
+      rowHeight = 0;
+    }
+    if (height < rowY + h) {
+      throw new RuntimeException("Atlas is too small to add another " + w + "x" + h + " video");
+    }
+    int index = add(video, rowX, rowY, w, h);
+    rowX += w;
+    rowHeight = Math.max(rowHeight, h);
+    return index;
+  }
+
+  /**
+   *  Adds a video at a given position of the atlas.
+   *  From then on, the video's frames only go to the atlas, and are no
+   *  longer available through read.
+   *  Parts of the rectangle outside of the atlas are left out.
+   *  @param video video to add
+   *  @param x x coordinate in the atlas
+   *  @param y y coordinate in the atlas
+   *  @param w width in the atlas
+   *  @param h height in the atlas
+   *  @return index of the video's rectangle
+   */
+  public int add(GLVideo video, int x, int y, int w, int h) {
+    if (w < 0 || h < 0) {
+      throw new IllegalArgumentException("Width and height can't be negative");
+    }
+    if (videos.contains(video)) {
+      throw new IllegalArgumentException("This video is already part of the atlas");
+    }
+    if (handle == 0 || video.handle == 0) {
+      throw new RuntimeException("The atlas or the video has already been closed");
+    }
+    if (!GLVideo.gstreamer_addToAtlas(handle, video.handle, x, y, w, h)) {
+      throw new RuntimeException("Could not add the video to the atlas");
+    }
+    videos.add(video);
+    rects.add(new int[] { x, y, w, h });
+    return videos.size() - 1;
+  }
+
+  /**
+   *  Returns the rectangle a video occupies in the atlas.
+   *  @param index index returned by add
+   *  @return x, y, width and height in pixels
+   */
+  public int[] rect(int index) {
+    return rects.get(index).clone();
+  }
+
+  /**
+   *  Returns the number of videos in the atlas.
+   */
+  public int size() {
+    return videos.size();
+  }
+
+  /**
+   *  Makes the frames copied into the atlas since the last call visible
+   *  to the sketch. This doesn't wait for the copies to finish, instead
+   *  the GPU does before drawing with the atlas.
+   *  Call this once per frame, before drawing the atlas.
+   */
+  public void update() {
+    if (handle == 0) {
+      return;
+    }
+
+    int texId = GLVideo.gstreamer_updateAtlas(handle);
+    if (texId == 0) {
+      // no frame arrived yet
+      return;
+    }
+    if (texture == null) {
+      PGraphicsOpenGL pg = (PGraphicsOpenGL)parent.g;
+      Texture.Parameters params = new Texture.Parameters(ARGB, BILINEAR, false, CLAMP);
+      texture = new Texture(pg, width, height, params);
+      pg.setCache(this, texture);
+    }
+    texture.glName = texId;
+    updates++;
+  }
+
+  /**
+   *  Returns statistics about the atlas, as measured while running.
+   *  The array contains the number of videos, the number of frames copied
+   *  into the atlas, the average and maximum time a copy took on the
+   *  streaming thread (us), the number of copies the GPU was told to wait
+   *  for, the GPU memory used by the atlas (bytes), the GPU memory of the
+   *  textures the videos still hold for the sketch (bytes), and the number
+   *  of updates.
+   */
+  public long[] stats() {
+    long[] copies = new long[4];
+    if (handle != 0) {
+      copies = GLVideo.gstreamer_getAtlasStats(handle);
+    }
+    long videoBytes = 0;
+    for (GLVideo video : videos) {
+      videoBytes += video.textureMemory();
+    }
+    return new long[] {
+      videos.size(),
+      copies[0],
+      copies[1],
+      copies[2],
+      copies[3],
+      (long) width * height * 4,
+      videoBytes,
+      updates
+    };
+  }
+
+  /**
+   *  Releases the atlas texture.
+   *  The videos themselves are not closed, and their frames become
+   *  available through read again.
+   */
+  public void close() {
+    if (handle != 0) {
+      GLVideo.gstreamer_closeAtlas(handle);
+      handle = 0;
+    }
+  }
+
+  public void dispose() {
+    close();
+  }
+}
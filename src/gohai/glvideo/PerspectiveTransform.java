@@ -39,6 +39,9 @@ public class PerspectiveTransform {
   protected float[] warpMat = new float[16];
   protected boolean dirty;
 
+  // below this number of points the JNI overhead outweighs the native kernel
+  protected static final int NATIVE_MIN_POINTS = 1024;
+
   /**
    *  Return the perspective transformation between two quads.
    *  The points (x/y0 to x/y3 and x/y0p to x/y3p) are assigned clockwise, starting
@@ -115,6 +118,35 @@ public class PerspectiveTransform {
     return new Point2D.Float(tmp[0], tmp[1]);
   }
 
+  /**
+   *  Transform a number of points at once.
+   *  This doesn't allocate any objects, and can be used with src and dst
+   *  being the same array.
+   *  @param src input coordinates (x0, y0, x1, y1, ...)
+   *  @param dst output coordinates (x0, y0, x1, y1, ...)
+   *  @param count number of points
+   */
+  public void transform(float[] src, float[] dst, int count) {
+    if (count < 0 || src.length < count*2 || dst.length < count*2) {
+      throw new IllegalArgumentException("src and dst need to hold " + count + " points");
+    }
+    if (dirty) {
+      computeWarp();
+    }
+    if (NATIVE_MIN_POINTS <= count && GLVideo.loaded) {
+      GLVideo.gstreamer_warpPoints(warpMat, src, dst, count);
+      return;
+    }
+    float[] mat = warpMat;
+    for (int i=0; i < count*2; i += 2) {
+      float x = src[i];
+      float y = src[i+1];
+      float w = 1.0f / (x*mat[3] + y*mat[7] + mat[15]);
+      dst[i]   = (x*mat[0] + y*mat[4] + mat[12]) * w;
+      dst[i+1] = (x*mat[1] + y*mat[5] + mat[13]) * w;
+    }
+  }
+
   protected void setIdentity() {
     setSource     (0.0f, 0.0f,
                    1.0f, 0.0f,
@@ -24,6 +24,9 @@ package gohai.glvideo;
 
 import gohai.glvideo.PerspectiveTransform;
 import java.awt.geom.Point2D;
+import java.util.Map;
+import java.util.WeakHashMap;
+import processing.core.*;
 
 /**
  *  @webref
@@ -31,6 +34,18 @@ import java.awt.geom.Point2D;
 public class WarpPerspective {
 
   protected PerspectiveTransform transform;
+  // state of every mesh created by createMesh(), dropped with the mesh
+  protected Map<PShape, Mesh> meshes = new WeakHashMap<PShape, Mesh>();
+
+  protected static class Mesh {
+    PImage tex;
+    int res;
+    // size of the image meshSrc was calculated for
+    int srcWidth;
+    int srcHeight;
+    float[] src;
+    float[] dst;
+  }
 
   /**
    *  Class for calculating the perspective transformation for a point
@@ -40,6 +55,14 @@ public class WarpPerspective {
     this.transform = transform;
   }
 
+  /**
+   *  Replace the perspective transformation, e.g. when a corner got moved
+   *  @param transform PerspectiveTransform instance to use
+   */
+  public void setTransform(PerspectiveTransform transform) {
+    this.transform = transform;
+  }
+
   /**
    *  Calculate the transformation for a point
    *  @param point input (Point2D)
@@ -58,4 +81,101 @@ public class WarpPerspective {
   public Point2D mapDestPoint(float x, float y) {
     return transform.transform(x, y);
   }
+
+  /**
+   *  Calculate the transformation for a number of points
+   *  @param src input coordinates (x0, y0, x1, y1, ...)
+   *  @param dst output coordinates (x0, y0, x1, y1, ...)
+   *  @param count number of points
+   */
+  public void mapDestPoints(float[] src, float[] dst, int count) {
+    transform.transform(src, dst, count);
+  }
+
+  /**
+   *  Create a textured mesh that maps an image onto the destination quad
+   *  The image is subdivided into res x res quads, which makes the
+   *  texture mapping appear perspective-correct.
+   *  @param parent typically use "this"
+   *  @param tex image or video to map
+   *  @param res number of subdivisions (e.g. 5 for 5x5)
+   *  @return PShape that can be drawn with shape()
+   */
+  public PShape createMesh(PApplet parent, PImage tex, int res) {
+    Mesh m = new Mesh();
+    m.tex = tex;
+    m.res = res;
+    m.src = new float[(res+1) * (res+1) * 2];
+    m.dst = new float[m.src.length];
+    updateGrid(m);
+
+    PShape mesh = parent.createShape();
+    mesh.beginShape(PConstants.QUADS);
+    mesh.textureMode(PConstants.NORMAL);
+    mesh.noStroke();
+    mesh.texture(tex);
+    mesh.normal(0, 0, 1);
+    for (int y=0; y < res; y++) {
+      for (int x=0; x < res; x++) {
+        meshVertex(mesh, m, x, y);
+        meshVertex(mesh, m, x+1, y);
+        meshVertex(mesh, m, x+1, y+1);
+        meshVertex(mesh, m, x, y+1);
+      }
+    }
+    mesh.endShape();
+    meshes.put(mesh, m);
+    return mesh;
+  }
+
+  /**
+   *  Update a mesh created by createMesh() for the current transformation
+   *  This only moves the existing vertices, and is fast enough to be
+   *  called every frame while dragging corners. The grid follows the
+   *  image's current size, e.g. once a video has delivered its first frame.
+   *  @param mesh PShape returned by createMesh()
+   */
+  public void updateMesh(PShape mesh) {
+    Mesh m = meshes.get(mesh);
+    if (m == null) {
+      throw new IllegalArgumentException("The mesh wasn't created by this WarpPerspective instance");
+    }
+    updateGrid(m);
+
+    int i = 0;
+    for (int y=0; y < m.res; y++) {
+      for (int x=0; x < m.res; x++) {
+        setMeshVertex(mesh, m, i++, x, y);
+        setMeshVertex(mesh, m, i++, x+1, y);
+        setMeshVertex(mesh, m, i++, x+1, y+1);
+        setMeshVertex(mesh, m, i++, x, y+1);
+      }
+    }
+  }
+
+  protected void updateGrid(Mesh m) {
+    int res = m.res;
+    if (m.srcWidth != m.tex.width || m.srcHeight != m.tex.height) {
+      // grid points of the source image
+      for (int y=0; y <= res; y++) {
+        for (int x=0; x <= res; x++) {
+          m.src[(y * (res+1) + x) * 2] = (float) x * m.tex.width / res;
+          m.src[(y * (res+1) + x) * 2 + 1] = (float) y * m.tex.height / res;
+        }
+      }
+      m.srcWidth = m.tex.width;
+      m.srcHeight = m.tex.height;
+    }
+    transform.transform(m.src, m.dst, (res+1) * (res+1));
+  }
+
+  protected void meshVertex(PShape mesh, Mesh m, int x, int y) {
+    int idx = (y * (m.res+1) + x) * 2;
+    mesh.vertex(m.dst[idx], m.dst[idx+1], (float) x / m.res, (float) y / m.res);
+  }
+
+  protected void setMeshVertex(PShape mesh, Mesh m, int i, int x, int y) {
+    int idx = (y * (m.res+1) + x) * 2;
+    mesh.setVertex(i, m.dst[idx], m.dst[idx+1]);
+  }
 }
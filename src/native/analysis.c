@@ -0,0 +1,435 @@
+/*
+  Copyright (c) The Processing Foundation 2016
+  Developed by Gottfried Haider
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>
+#include "analysis.h"
+
+// only every other row is looked at, which is plenty for presence detection
+#define GLVIDEO_ANALYSIS_ROW_STEP 2
+
+// 16-bit column sums overflow after this many rows, see add_row
+#define GLVIDEO_ANALYSIS_FLUSH_ROWS 256
+
+typedef guint8 v16qu __attribute__ ((vector_size (16)));
+typedef guint16 v8hu __attribute__ ((vector_size (16)));
+
+void
+analysis_histogram (const guint8 * luma, int width, int height, int stride,
+    int pixel_stride, guint32 * hist)
+{
+  // four partial histograms, so that runs of similar pixels don't stall
+  // on incrementing the same counter
+  guint32 part[4][GLVIDEO_ANALYSIS_BINS];
+  memset (part, 0, sizeof (part));
+
+  for (int y=0; y < height; y += GLVIDEO_ANALYSIS_ROW_STEP) {
+    const guint8 *p = luma + y * stride;
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+      part[0][p[0]]++;
+      part[1][p[pixel_stride]]++;
+      part[2][p[pixel_stride * 2]]++;
+      part[3][p[pixel_stride * 3]]++;
+      p += pixel_stride * 4;
+    }
+    for (; x < width; x++) {
+      part[0][p[0]]++;
+      p += pixel_stride;
+    }
+  }
+
+  for (int i=0; i < GLVIDEO_ANALYSIS_BINS; i++) {
+    hist[i] = part[0][i] + part[1][i] + part[2][i] + part[3][i];
+  }
+}
+
+// index of column x in the sums of add_row
+static inline int
+col_index (int x)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  int odd = (x & 1) ? 8 : 0;
+#else
+  int odd = (x & 1) ? 0 : 8;
+#endif
+  return (x & ~15) + odd + ((x & 15) >> 1);
+}
+
+// adds a row of tightly packed luma to 16-bit column sums, sixteen pixels
+// at a time, every sixteen columns are stored as the even ones followed
+// by the odd ones, which is how they come out of widening
+static void
+add_row (const guint8 * row, int width, guint16 * cols)
+{
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    v16qu a;
+    v8hu even, odd;
+    memcpy (&a, row + x, 16);
+    memcpy (&even, cols + x, 16);
+    memcpy (&odd, cols + x + 8, 16);
+    // the low and high byte of every pair of pixels
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+    even += (v8hu) a & 0xff;
+    odd += (v8hu) a >> 8;
+#else
+    even += (v8hu) a >> 8;
+    odd += (v8hu) a & 0xff;
+#endif
+    memcpy (cols + x, &even, 16);
+    memcpy (cols + x + 8, &odd, 16);
+  }
+  for (; x < width; x++) {
+    cols[col_index (x)] += row[x];
+  }
+}
+
+// adds the column sums to the sums of every cell, and clears them
+static void
+flush_cols (guint16 * cols, int cols_len, const int * x_start, int grid_width,
+    guint32 * sums)
+{
+  for (int gx=0; gx < grid_width; gx++) {
+    guint32 sum = 0;
+    for (int x=x_start[gx]; x < x_start[gx+1]; x++) {
+      sum += cols[col_index (x)];
+    }
+    sums[gx] += sum;
+  }
+  memset (cols, 0, cols_len * sizeof (*cols));
+}
+
+void
+analysis_downsample (const guint8 * luma, int width, int height, int stride,
+    int pixel_stride, guint8 * grid, int grid_width, int grid_height,
+    guint32 * sums, int * x_start, guint16 * cols)
+{
+  int cols_len = GLVIDEO_ANALYSIS_COLS_LEN (width);
+
+  for (int gx=0; gx <= grid_width; gx++) {
+    x_start[gx] = gx * width / grid_width;
+  }
+  if (pixel_stride == 1) {
+    memset (cols, 0, cols_len * sizeof (*cols));
+  }
+
+  for (int gy=0; gy < grid_height; gy++) {
+    int y0 = gy * height / grid_height;
+    int y1 = (gy + 1) * height / grid_height;
+    int rows = 0;
+    memset (sums, 0, grid_width * sizeof (*sums));
+
+    if (pixel_stride == 1) {
+      // sum up the columns of the whole band first, and only then the cells,
+      // so that narrow cells don't keep the rows from being vectorized
+      int pending = 0;
+      for (int y=y0; y < y1; y += GLVIDEO_ANALYSIS_ROW_STEP) {
+        add_row (luma + y * stride, width, cols);
+        rows++;
+        if (++pending == GLVIDEO_ANALYSIS_FLUSH_ROWS) {
+          flush_cols (cols, cols_len, x_start, grid_width, sums);
+          pending = 0;
+        }
+      }
+      if (pending) {
+        flush_cols (cols, cols_len, x_start, grid_width, sums);
+      }
+    } else {
+      for (int y=y0; y < y1; y += GLVIDEO_ANALYSIS_ROW_STEP) {
+        const guint8 *row = luma + y * stride;
+        for (int gx=0; gx < grid_width; gx++) {
+          const guint8 *p = row + x_start[gx] * pixel_stride;
+          const guint8 *end = row + x_start[gx+1] * pixel_stride;
+          guint32 sum = 0;
+          for (; p < end; p += pixel_stride) {
+            sum += *p;
+          }
+          sums[gx] += sum;
+        }
+        rows++;
+      }
+    }
+
+    for (int gx=0; gx < grid_width; gx++) {
+      int n = rows * (x_start[gx+1] - x_start[gx]);
+      grid[gy * grid_width + gx] = (n) ? sums[gx] / n : 0;
+    }
+  }
+}
+
+int
+analysis_diff (const guint8 * cur, const guint8 * prev, guint8 * diff, int len,
+    int threshold)
+{
+  v16qu t = (v16qu) {} + (guint8) threshold;
+  v16qu count = {};
+  int changed = 0;
+  int blocks = 0;
+  int i = 0;
+
+  // sixteen cells at a time
+  for (; i + 16 <= len; i += 16) {
+    v16qu a, b;
+    memcpy (&a, cur + i, 16);
+    memcpy (&b, prev + i, 16);
+    // absolute difference, without widening
+    v16qu gt = (v16qu) (a > b);
+    v16qu d = ((a - b) & gt) | ((b - a) & ~gt);
+    memcpy (diff + i, &d, 16);
+    // comparisons yield -1 for true
+    count -= (v16qu) (d > t);
+
+    // flush before the per-lane counters can overflow
+    if (++blocks == 255 || len < i + 32) {
+      for (int j=0; j < 16; j++) {
+        changed += count[j];
+      }
+      count = (v16qu) {};
+      blocks = 0;
+    }
+  }
+  for (; i < len; i++) {
+    diff[i] = (cur[i] > prev[i]) ? cur[i] - prev[i] : prev[i] - cur[i];
+    if (threshold < diff[i]) {
+      changed++;
+    }
+  }
+  return changed;
+}
+
+gboolean
+analysis_bbox (const guint8 * diff, int grid_width, int grid_height,
+    int threshold, int * bbox)
+{
+  int min_x = grid_width;
+  int min_y = grid_height;
+  int max_x = -1;
+  int max_y = -1;
+
+  for (int gy=0; gy < grid_height; gy++) {
+    const guint8 *row = diff + gy * grid_width;
+    for (int gx=0; gx < grid_width; gx++) {
+      if (threshold < row[gx]) {
+        min_x = MIN (min_x, gx);
+        max_x = MAX (max_x, gx);
+        min_y = MIN (min_y, gy);
+        max_y = MAX (max_y, gy);
+      }
+    }
+  }
+
+  if (max_x < 0) {
+    bbox[0] = bbox[1] = bbox[2] = bbox[3] = 0;
+    return FALSE;
+  }
+  // in cells, including the last one
+  bbox[0] = min_x;
+  bbox[1] = min_y;
+  bbox[2] = max_x - min_x + 1;
+  bbox[3] = max_y - min_y + 1;
+  return TRUE;
+}
+
+void
+analysis_init (GLVIDEO_ANALYSIS_T * analysis)
+{
+  memset (analysis, 0, sizeof (*analysis));
+  g_mutex_init (&analysis->lock);
+}
+
+void
+analysis_clear (GLVIDEO_ANALYSIS_T * analysis)
+{
+  g_free (analysis->diff);
+  g_free (analysis->work_grid);
+  g_free (analysis->work_prev);
+  g_free (analysis->work_diff);
+  g_free (analysis->work_sums);
+  g_free (analysis->work_x_start);
+  g_free (analysis->work_cols);
+  if (analysis->caps) {
+    gst_caps_unref (analysis->caps);
+  }
+  g_mutex_clear (&analysis->lock);
+}
+
+void
+analysis_configure (GLVIDEO_ANALYSIS_T * analysis, int grid_width,
+    int grid_height, int threshold)
+{
+  // this also keeps grid_width * grid_height from overflowing
+  grid_width = MIN (grid_width, GLVIDEO_ANALYSIS_MAX_GRID);
+  grid_height = MIN (grid_height, GLVIDEO_ANALYSIS_MAX_GRID);
+
+  g_mutex_lock (&analysis->lock);
+  analysis->enabled = (0 < grid_width && 0 < grid_height);
+  analysis->grid_width = grid_width;
+  analysis->grid_height = grid_height;
+  analysis->threshold = CLAMP (threshold, 0, 255);
+  if (analysis->diff_len != grid_width * grid_height) {
+    g_free (analysis->diff);
+    analysis->diff_len = MAX (grid_width * grid_height, 0);
+    analysis->diff = g_new0 (guint8, analysis->diff_len);
+  }
+  analysis->changed = 0;
+  analysis->frames = 0;
+  memset (analysis->bbox, 0, sizeof (analysis->bbox));
+  g_mutex_unlock (&analysis->lock);
+}
+
+static gboolean
+luma_layout (GstVideoFormat format, int * offset, int * pixel_stride)
+{
+  switch (format) {
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YV12:
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_NV21:
+    case GST_VIDEO_FORMAT_NV16:
+    case GST_VIDEO_FORMAT_Y41B:
+    case GST_VIDEO_FORMAT_Y42B:
+    case GST_VIDEO_FORMAT_Y444:
+    case GST_VIDEO_FORMAT_GRAY8:
+      *offset = 0;
+      *pixel_stride = 1;
+      return TRUE;
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_YVYU:
+      *offset = 0;
+      *pixel_stride = 2;
+      return TRUE;
+    case GST_VIDEO_FORMAT_UYVY:
+      *offset = 1;
+      *pixel_stride = 2;
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+void
+analysis_process (GLVIDEO_ANALYSIS_T * analysis, GstBuffer * buffer,
+    GstCaps * caps)
+{
+  int grid_width, grid_height, threshold;
+  int offset, pixel_stride;
+
+  g_mutex_lock (&analysis->lock);
+  gboolean enabled = analysis->enabled;
+  grid_width = analysis->grid_width;
+  grid_height = analysis->grid_height;
+  threshold = analysis->threshold;
+  g_mutex_unlock (&analysis->lock);
+
+  if (!enabled || !caps) {
+    return;
+  }
+
+  if (caps != analysis->caps) {
+    gst_caps_replace (&analysis->caps, caps);
+    GstCapsFeatures *features = gst_caps_get_features (caps, 0);
+    // frames already in GPU memory would need to be downloaded first
+    analysis->unsupported = !gst_video_info_from_caps (&analysis->info, caps) ||
+        (features && !gst_caps_features_is_any (features) &&
+         !gst_caps_features_contains (features, GST_CAPS_FEATURE_MEMORY_SYSTEM_MEMORY)) ||
+        !luma_layout (GST_VIDEO_INFO_FORMAT (&analysis->info), &offset, &pixel_stride);
+    if (analysis->unsupported) {
+      gchar *str = gst_caps_to_string (caps);
+      g_printerr ("GLVideo: Frame analysis doesn't support %s\n", str);
+      g_free (str);
+    }
+    analysis->has_prev = FALSE;
+  }
+  if (analysis->unsupported) {
+    return;
+  }
+  luma_layout (GST_VIDEO_INFO_FORMAT (&analysis->info), &offset, &pixel_stride);
+
+  if (analysis->work_width != grid_width || analysis->work_height != grid_height) {
+    g_free (analysis->work_grid);
+    g_free (analysis->work_prev);
+    g_free (analysis->work_diff);
+    g_free (analysis->work_sums);
+    g_free (analysis->work_x_start);
+    analysis->work_grid = g_new0 (guint8, grid_width * grid_height);
+    analysis->work_prev = g_new0 (guint8, grid_width * grid_height);
+    analysis->work_diff = g_new0 (guint8, grid_width * grid_height);
+    analysis->work_sums = g_new0 (guint32, grid_width);
+    analysis->work_x_start = g_new0 (int, grid_width + 1);
+    analysis->work_width = grid_width;
+    analysis->work_height = grid_height;
+    analysis->has_prev = FALSE;
+  }
+
+  GstVideoFrame frame;
+  if (!gst_video_frame_map (&frame, &analysis->info, buffer, GST_MAP_READ)) {
+    return;
+  }
+  const guint8 *luma = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&frame, 0) + offset;
+  int stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0);
+  int width = GST_VIDEO_FRAME_WIDTH (&frame);
+  int height = GST_VIDEO_FRAME_HEIGHT (&frame);
+  if (analysis->work_cols_len < GLVIDEO_ANALYSIS_COLS_LEN (width)) {
+    g_free (analysis->work_cols);
+    analysis->work_cols_len = GLVIDEO_ANALYSIS_COLS_LEN (width);
+    analysis->work_cols = g_new (guint16, analysis->work_cols_len);
+  }
+
+  analysis_histogram (luma, width, height, stride, pixel_stride, analysis->work_histogram);
+  analysis_downsample (luma, width, height, stride, pixel_stride,
+      analysis->work_grid, grid_width, grid_height,
+      analysis->work_sums, analysis->work_x_start, analysis->work_cols);
+  gst_video_frame_unmap (&frame);
+
+  int len = grid_width * grid_height;
+  int changed = 0;
+  int bbox[4] = { 0, 0, 0, 0 };
+  if (analysis->has_prev) {
+    changed = analysis_diff (analysis->work_grid, analysis->work_prev,
+        analysis->work_diff, len, threshold);
+    if (analysis_bbox (analysis->work_diff, grid_width, grid_height, threshold, bbox)) {
+      // cells to pixels
+      int x0 = bbox[0] * width / grid_width;
+      int y0 = bbox[1] * height / grid_height;
+      bbox[2] = (bbox[0] + bbox[2]) * width / grid_width - x0;
+      bbox[3] = (bbox[1] + bbox[3]) * height / grid_height - y0;
+      bbox[0] = x0;
+      bbox[1] = y0;
+    }
+  } else {
+    memset (analysis->work_diff, 0, len);
+  }
+  // the current grid becomes the previous one
+  guint8 *tmp = analysis->work_prev;
+  analysis->work_prev = analysis->work_grid;
+  analysis->work_grid = tmp;
+  analysis->has_prev = TRUE;
+
+  g_mutex_lock (&analysis->lock);
+  // skip if the grid was changed in the meantime
+  if (analysis->diff_len == len) {
+    memcpy (analysis->histogram, analysis->work_histogram, sizeof (analysis->histogram));
+    memcpy (analysis->diff, analysis->work_diff, len);
+    memcpy (analysis->bbox, bbox, sizeof (bbox));
+    analysis->changed = changed;
+    analysis->frames++;
+  }
+  g_mutex_unlock (&analysis->lock);
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) The Processing Foundation 2016
+  Developed by Gottfried Haider
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#define GLVIDEO_ANALYSIS_BINS 256
+// largest grid in either direction, see analysis_configure
+#define GLVIDEO_ANALYSIS_MAX_GRID 256
+// column sums analysis_downsample needs for a frame, in whole vectors
+#define GLVIDEO_ANALYSIS_COLS_LEN(width) (((width) + 15) & ~15)
+
+typedef struct {
+  GMutex lock;
+  // protects the following
+  gboolean enabled;
+  int grid_width;
+  int grid_height;
+  int threshold;
+  // results of the last frame
+  guint32 histogram[GLVIDEO_ANALYSIS_BINS];
+  guint8 *diff;
+  int diff_len;
+  // in pixels, empty if there was no motion
+  int bbox[4];
+  int changed;
+  guint64 frames;
+
+  // only touched by the streaming thread
+  GstCaps *caps;
+  GstVideoInfo info;
+  gboolean unsupported;
+  int work_width;
+  int work_height;
+  guint8 *work_grid;
+  guint8 *work_prev;
+  guint8 *work_diff;
+  // scratch space for analysis_downsample, grid_width + 1 entries
+  guint32 *work_sums;
+  int *work_x_start;
+  // scratch space for analysis_downsample, GLVIDEO_ANALYSIS_COLS_LEN(frame width) entries
+  guint16 *work_cols;
+  int work_cols_len;
+  guint32 work_histogram[GLVIDEO_ANALYSIS_BINS];
+  gboolean has_prev;
+} GLVIDEO_ANALYSIS_T;
+
+void analysis_init (GLVIDEO_ANALYSIS_T * analysis);
+void analysis_clear (GLVIDEO_ANALYSIS_T * analysis);
+void analysis_configure (GLVIDEO_ANALYSIS_T * analysis, int grid_width, int grid_height, int threshold);
+void analysis_process (GLVIDEO_ANALYSIS_T * analysis, GstBuffer * buffer, GstCaps * caps);
+
+// kernels, luma is read every pixel_stride bytes
+void analysis_histogram (const guint8 * luma, int width, int height, int stride, int pixel_stride, guint32 * hist);
+void analysis_downsample (const guint8 * luma, int width, int height, int stride, int pixel_stride, guint8 * grid, int grid_width, int grid_height, guint32 * sums, int * x_start, guint16 * cols);
+int analysis_diff (const guint8 * cur, const guint8 * prev, guint8 * diff, int len, int threshold);
+gboolean analysis_bbox (const guint8 * diff, int grid_width, int grid_height, int threshold, int * bbox);
+
+#endif
@@ -11,6 +11,10 @@ extern "C" {
 #define gohai_glvideo_GLVideo_MUTE 1L
 #undef gohai_glvideo_GLVideo_NO_SYNC
 #define gohai_glvideo_GLVideo_NO_SYNC 2L
+#undef gohai_glvideo_GLVideo_DOWNLOAD
+#define gohai_glvideo_GLVideo_DOWNLOAD 4L
+#undef gohai_glvideo_GLVideo_SCALABLE
+#define gohai_glvideo_GLVideo_SCALABLE 8L
 /*
  * Class:     gohai_glvideo_GLVideo
  * Method:    gstreamer_setEnvVar
@@ -27,6 +31,70 @@ JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setEnvVar
 JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1init
   (JNIEnv *, jclass);
 
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setSharedContexts
+ * Signature: (I)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setSharedContexts
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setBufferPool
+ * Signature: (II)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setBufferPool
+  (JNIEnv *, jclass, jint, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setRingBufferSize
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setRingBufferSize
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setDecoderRank
+ * Signature: (Ljava/lang/String;I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setDecoderRank
+  (JNIEnv *, jclass, jstring, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setDecoderThreads
+ * Signature: (I)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setDecoderThreads
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setDecoderQueue
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setDecoderQueue
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getPluginDir
+ * Signature: ()Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getPluginDir
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_loadPlugins
+ * Signature: ([Ljava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1loadPlugins
+  (JNIEnv *, jclass, jobjectArray);
+
 /*
  * Class:     gohai_glvideo_GLVideo
  * Method:    gstreamer_filenameToUri
@@ -43,6 +111,22 @@ JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1filenameToUri
 JNIEXPORT jobjectArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDevices
   (JNIEnv *, jclass);
 
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_negotiateDeviceCaps
+ * Signature: (Ljava/lang/String;IIF)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1negotiateDeviceCaps
+  (JNIEnv *, jclass, jstring, jint, jint, jfloat);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getResourceStats
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getResourceStats
+  (JNIEnv *, jclass);
+
 /*
  * Class:     gohai_glvideo_GLVideo
  * Method:    gstreamer_openPipeline
@@ -70,10 +154,10 @@ JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1isAvailable
 /*
  * Class:     gohai_glvideo_GLVideo
  * Method:    gstreamer_getFrame
- * Signature: (J)I
+ * Signature: (JI)I
  */
 JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getFrame
-  (JNIEnv *, jclass, jlong);
+  (JNIEnv *, jclass, jlong, jint);
 
 /*
  * Class:     gohai_glvideo_GLVideo
@@ -115,6 +199,14 @@ JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setLooping
 JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1seek
   (JNIEnv *, jclass, jlong, jfloat);
 
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_step
+ * Signature: (JI)J
+ */
+JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1step
+  (JNIEnv *, jclass, jlong, jint);
+
 /*
  * Class:     gohai_glvideo_GLVideo
  * Method:    gstreamer_setSpeed
@@ -171,6 +263,134 @@ JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getHeight
 JNIEXPORT jfloat JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getFramerate
   (JNIEnv *, jclass, jlong);
 
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setBufferingWatermarks
+ * Signature: (JII)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setBufferingWatermarks
+  (JNIEnv *, jclass, jlong, jint, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getBufferingStats
+ * Signature: (J)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getBufferingStats
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getTextureMemory
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getTextureMemory
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getRegions
+ * Signature: (J[I)[I
+ */
+JNIEXPORT jintArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getRegions
+  (JNIEnv *, jclass, jlong, jintArray);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setAdaptive
+ * Signature: (JZ)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setAdaptive
+  (JNIEnv *, jclass, jlong, jboolean);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getAdaptiveStats
+ * Signature: (J)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getAdaptiveStats
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setCues
+ * Signature: (J[F)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setCues
+  (JNIEnv *, jclass, jlong, jfloatArray);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_addShader
+ * Signature: (JLjava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1addShader
+  (JNIEnv *, jclass, jlong, jstring);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setShaderUniforms
+ * Signature: (JILjava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setShaderUniforms
+  (JNIEnv *, jclass, jlong, jint, jstring);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_removeShader
+ * Signature: (JI)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1removeShader
+  (JNIEnv *, jclass, jlong, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_setAnalysis
+ * Signature: (JIII)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setAnalysis
+  (JNIEnv *, jclass, jlong, jint, jint, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getHistogram
+ * Signature: (J)[I
+ */
+JNIEXPORT jintArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getHistogram
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getDifference
+ * Signature: (J)[I
+ */
+JNIEXPORT jintArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDifference
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getMotion
+ * Signature: (J)[I
+ */
+JNIEXPORT jintArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getMotion
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getFrameDescriptor
+ * Signature: (J)Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getFrameDescriptor
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getDecoder
+ * Signature: (J)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDecoder
+  (JNIEnv *, jclass, jlong);
+
 /*
  * Class:     gohai_glvideo_GLVideo
  * Method:    gstreamer_close
@@ -179,6 +399,94 @@ JNIEXPORT jfloat JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getFramerate
 JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1close
   (JNIEnv *, jclass, jlong);
 
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_openRecorder
+ * Signature: (Ljava/lang/String;Ljava/lang/String;IIIIZ)J
+ */
+JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1openRecorder
+  (JNIEnv *, jclass, jstring, jstring, jint, jint, jint, jint, jboolean);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_recorderAddFrame
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1recorderAddFrame
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getRecorderStats
+ * Signature: (J)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getRecorderStats
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_closeRecorder
+ * Signature: (JZ)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1closeRecorder
+  (JNIEnv *, jclass, jlong, jboolean);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_extractThumbnails
+ * Signature: ([Ljava/lang/String;[FIIZI)[[I
+ */
+JNIEXPORT jobjectArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1extractThumbnails
+  (JNIEnv *, jclass, jobjectArray, jfloatArray, jint, jint, jboolean, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_warpPoints
+ * Signature: ([F[F[FI)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1warpPoints
+  (JNIEnv *, jclass, jfloatArray, jfloatArray, jfloatArray, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_openAtlas
+ * Signature: (II)J
+ */
+JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1openAtlas
+  (JNIEnv *, jclass, jint, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_addToAtlas
+ * Signature: (JJIIII)Z
+ */
+JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1addToAtlas
+  (JNIEnv *, jclass, jlong, jlong, jint, jint, jint, jint);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_updateAtlas
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1updateAtlas
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_getAtlasStats
+ * Signature: (J)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getAtlasStats
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     gohai_glvideo_GLVideo
+ * Method:    gstreamer_closeAtlas
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1closeAtlas
+  (JNIEnv *, jclass, jlong);
+
 #ifdef __cplusplus
 }
 #endif
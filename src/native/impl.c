@@ -35,9 +35,15 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#define _GNU_SOURCE
 #define GST_USE_UNSTABLE_API
+// for pixel buffer objects, see GLRecorder
+#define GL_GLEXT_PROTOTYPES
+#include <dlfcn.h>
 #include <gst/gst.h>
 #include <gst/gl/gl.h>
+#include <gst/gl/gstglfuncs.h>
+#include <gst/video/video.h>
 #ifdef __APPLE__
 #elif GLES2
 #include <gst/gl/egl/gstgldisplay_egl.h>
@@ -46,11 +52,22 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <gst/gl/x11/gstgldisplay_x11.h>
 #endif
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "analysis.h"
 #include "impl.h"
 #include "iface.h"
 
+// for fences, see atlas_copy_cb, OpenGL ES 2.0 headers lack these
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_TIMEOUT_IGNORED
+#define GL_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
+#endif
+
 #define likely(x)   __builtin_expect((x),1)
 #define unlikely(x) __builtin_expect((x),0)
 
@@ -78,6 +95,52 @@ static GstGLDisplayEGL *gst_display;
 static GstGLDisplayX11 *gst_display;
 #endif
 
+// shared by all pipelines, see acquire_gl_contexts
+#define GLVIDEO_MAX_SHARED_CONTEXTS 8
+static GMutex context_lock;
+// protects the following
+static GstGLContext *wrapped_context;
+static GstGLContext *shared_contexts[GLVIDEO_MAX_SHARED_CONTEXTS];
+static int shared_context_users[GLVIDEO_MAX_SHARED_CONTEXTS];
+static int num_shared_contexts = 1;
+static int context_users;
+
+// configuration for newly created pipelines, see handle_allocation_query
+static int pool_min_buffers;
+static int pool_max_buffers;
+static gint64 ring_buffer_size = 32 * 1024 * 1024;
+// see configure_element
+static int decoder_threads;
+static gint64 decoder_queue_time;
+
+// resource accounting, see getResourceStats
+static GMutex resource_lock;
+// protects the following
+static guint64 pipelines_opened;
+static guint64 pipelines_closed;
+static guint64 pipelines_failed;
+static gint64 open_time_total;
+static gint64 open_time_max;
+static guint64 first_frames;
+static gint64 first_frame_total;
+static gint64 first_frame_max;
+// updated atomically
+static gint live_textures;
+static gint live_gl_objects;
+
+// persistent device monitor, see ensure_device_monitor
+static GMutex device_lock;
+// protects the following
+static GstDeviceMonitor *device_monitor;
+static GList *device_list;
+
+// for calling back into Java
+static JavaVM *jvm;
+static jclass capture_class;
+static jmethodID device_event_method;
+static jclass video_class;
+static jmethodID cue_event_method;
+
 static GThread *thread;
 static GMainLoop *mainloop;
 #ifdef __APPLE__
@@ -91,13 +154,342 @@ static Display* display;
 static GLXContext context;
 #endif
 
+static JNIEnv *
+get_jni_env ()
+{
+  JNIEnv *env = NULL;
+  if ((*jvm)->GetEnv (jvm, (void **) &env, JNI_VERSION_1_6) == JNI_EDETACHED) {
+    // the thread stays attached, which makes subsequent callbacks cheap
+    (*jvm)->AttachCurrentThreadAsDaemon (jvm, (void **) &env, NULL);
+  }
+  return env;
+}
+
+static void
+cue_destroy (gpointer data)
+{
+  g_slice_free (GLVIDEO_CUE_T, data);
+}
+
+static gboolean
+cue_cb (GstClock * clock, GstClockTime time, GstClockID id, gpointer user_data)
+{
+  GLVIDEO_CUE_T *cue = (GLVIDEO_CUE_T *) user_data;
+
+  g_atomic_int_set (&cue->fired, 1);
+
+  // this is called from the clock's thread, right at the cue's running time
+  JNIEnv *env = get_jni_env ();
+  if (!env || !cue_event_method) {
+    return TRUE;
+  }
+  (*env)->CallStaticVoidMethod (env, video_class, cue_event_method,
+      cue->handle, (jint) cue->index, (jlong) cue->stream_time);
+  if ((*env)->ExceptionCheck (env)) {
+    (*env)->ExceptionDescribe (env);
+    (*env)->ExceptionClear (env);
+  }
+  return TRUE;
+}
+
+// must be called with buffer_lock held
+static void
+unschedule_cues (GLVIDEO_STATE_T * state)
+{
+  GList *iter;
+
+  for (iter = state->cue_pending; iter != NULL; iter = iter->next) {
+    GLVIDEO_CUE_T *cue = iter->data;
+    if (!g_atomic_int_get (&cue->fired)) {
+      gst_clock_id_unschedule (cue->id);
+      // reschedule it later
+      state->cue_next = MIN (state->cue_next, cue->index);
+    }
+    // the cue gets freed once the clock doesn't need it anymore either
+    gst_clock_id_unref (cue->id);
+  }
+  g_list_free (state->cue_pending);
+  state->cue_pending = NULL;
+}
+
+// must be called with buffer_lock held
+static void
+reset_cues (GLVIDEO_STATE_T * state, GstClockTime stream_time)
+{
+  unschedule_cues (state);
+  state->cue_next = 0;
+  while (state->cue_next < state->cues->len &&
+      g_array_index (state->cues, GstClockTime, state->cue_next) < stream_time) {
+    state->cue_next++;
+  }
+}
+
+// must be called with buffer_lock held
+static void
+schedule_cues (GLVIDEO_STATE_T * state, GstBuffer * buffer)
+{
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+  GstClockTime duration = GST_BUFFER_DURATION (buffer);
+  GList *iter;
+
+  // drop the cues that already fired
+  iter = state->cue_pending;
+  while (iter != NULL) {
+    GList *next = iter->next;
+    GLVIDEO_CUE_T *cue = iter->data;
+    if (g_atomic_int_get (&cue->fired)) {
+      gst_clock_id_unref (cue->id);
+      state->cue_pending = g_list_delete_link (state->cue_pending, iter);
+    }
+    iter = next;
+  }
+
+  if (state->cue_next >= state->cues->len || !GST_CLOCK_TIME_IS_VALID (pts) ||
+      state->segment.format != GST_FORMAT_TIME || state->segment.rate < 0) {
+    return;
+  }
+  if (!GST_CLOCK_TIME_IS_VALID (duration)) {
+    duration = 40 * GST_MSECOND;
+  }
+
+  GstClock *clock = gst_element_get_clock (state->pipeline);
+  if (!clock) {
+    return;
+  }
+  GstClockTime base_time = gst_element_get_base_time (state->pipeline);
+  guint64 end = gst_segment_to_stream_time (&state->segment, GST_FORMAT_TIME, pts);
+  if (end == -1) {
+    gst_object_unref (clock);
+    return;
+  }
+  end += duration;
+
+  // this buffer is being rendered now, so schedule all cues until the next one
+  // on the pipeline clock, rather than firing them with frame granularity
+  while (state->cue_next < state->cues->len) {
+    GstClockTime cue_time = g_array_index (state->cues, GstClockTime, state->cue_next);
+    if (end <= cue_time) {
+      break;
+    }
+    guint64 pos = gst_segment_position_from_stream_time (&state->segment, GST_FORMAT_TIME, cue_time);
+    guint64 running_time = gst_segment_to_running_time (&state->segment, GST_FORMAT_TIME, pos);
+    if (running_time != -1) {
+      GLVIDEO_CUE_T *cue = g_slice_new0 (GLVIDEO_CUE_T);
+      cue->handle = (intptr_t) state;
+      cue->index = state->cue_next;
+      cue->stream_time = cue_time;
+      cue->id = gst_clock_new_single_shot_id (clock, base_time + running_time);
+      // cues that are already due fire right away
+      gst_clock_id_wait_async (cue->id, cue_cb, cue, cue_destroy);
+      state->cue_pending = g_list_prepend (state->cue_pending, cue);
+    }
+    state->cue_next++;
+  }
+
+  gst_object_unref (clock);
+}
+
+// must be called with buffer_lock held, which serializes the writers
+static void
+publish_frame_desc (GLVIDEO_STATE_T * state)
+{
+  GLVIDEO_FRAME_DESC_T *desc = &state->desc;
+  gint64 position = -1;
+
+  if (state->segment.format == GST_FORMAT_TIME && GST_CLOCK_TIME_IS_VALID (state->next_pts)) {
+    position = gst_segment_to_stream_time (&state->segment, GST_FORMAT_TIME, state->next_pts);
+  }
+
+  // seqlock: readers retry until they see the same even value before and after
+  // reading, g_atomic_int_inc is a full barrier
+  g_atomic_int_inc (&desc->seq);
+  desc->tex = state->next_tex;
+  desc->width = state->width;
+  desc->height = state->height;
+  desc->playing = state->playing_requested;
+  desc->pts = GST_CLOCK_TIME_IS_VALID (state->next_pts) ? (gint64) state->next_pts : -1;
+  desc->position = position;
+  desc->duration = state->duration;
+  desc->frames = state->frame_serial;
+  desc->missed = state->total_missed + state->frames_missed;
+  g_atomic_int_inc (&desc->seq);
+}
+
+typedef struct {
+  GLVIDEO_ATLAS_T *atlas;
+  GLVIDEO_STATE_T *state;
+  GstGLMemory *mem;
+} GLVIDEO_ATLAS_COPY_T;
+
+// this runs on the GL thread of the context the frame was uploaded with
+static void
+atlas_copy_cb (GstGLContext * context, gpointer data)
+{
+  GLVIDEO_ATLAS_COPY_T *copy = (GLVIDEO_ATLAS_COPY_T *) data;
+  GLVIDEO_ATLAS_T *atlas = copy->atlas;
+  GLVIDEO_STATE_T *state = copy->state;
+  const GstGLFuncs *gl = context->gl_vtable;
+  int frame_width = gst_gl_memory_get_texture_width (copy->mem);
+  int frame_height = gst_gl_memory_get_texture_height (copy->mem);
+  GLint prev_fbo;
+  GLint prev_tex;
+
+  glGetIntegerv (GL_FRAMEBUFFER_BINDING, &prev_fbo);
+  glGetIntegerv (GL_TEXTURE_BINDING_2D, &prev_tex);
+
+  g_mutex_lock (&atlas->lock);
+  if (!atlas->tex) {
+    // textures are shared between all contexts, framebuffers aren't
+    glGenTextures (1, &atlas->tex);
+    glBindTexture (GL_TEXTURE_2D, atlas->tex);
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, atlas->width, atlas->height, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    atlas->context = gst_object_ref (context);
+    g_atomic_int_inc (&live_gl_objects);
+  }
+  GLuint tex = atlas->tex;
+  g_mutex_unlock (&atlas->lock);
+
+  if (!state->atlas_fbo) {
+    glGenFramebuffers (1, &state->atlas_fbo);
+    state->atlas_fbo_context = gst_object_ref (context);
+    g_atomic_int_inc (&live_gl_objects);
+  }
+
+  glBindFramebuffer (GL_FRAMEBUFFER, state->atlas_fbo);
+  glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+      copy->mem->tex_id, 0);
+  glBindTexture (GL_TEXTURE_2D, tex);
+
+  g_mutex_lock (&atlas->lock);
+  for (guint i=0; i < atlas->tiles->len; i++) {
+    GLVIDEO_ATLAS_TILE_T *tile = &g_array_index (atlas->tiles, GLVIDEO_ATLAS_TILE_T, i);
+    if (tile->state != state) {
+      continue;
+    }
+    // the rectangle is already inside the atlas, also don't read outside of the frame
+    int w = MIN (tile->rect[2], frame_width);
+    int h = MIN (tile->rect[3], frame_height);
+    if (0 < w && 0 < h) {
+      glCopyTexSubImage2D (GL_TEXTURE_2D, 0, tile->rect[0], tile->rect[1], 0, 0, w, h);
+    }
+    // lets updateAtlas wait for the copy on the GPU, rather than calling glFinish
+    GLsync sync = NULL;
+    if (gl->FenceSync) {
+      sync = gl->FenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    if (tile->sync) {
+      gl->DeleteSync (tile->sync);
+    }
+    tile->sync = sync;
+  }
+  g_mutex_unlock (&atlas->lock);
+
+  glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+  glBindTexture (GL_TEXTURE_2D, prev_tex);
+  glBindFramebuffer (GL_FRAMEBUFFER, prev_fbo);
+  // the fences only become visible to other contexts once flushed
+  glFlush ();
+}
+
+static void
+atlas_copy_frame (GLVIDEO_ATLAS_T * atlas, GLVIDEO_STATE_T * state, GstGLMemory * mem)
+{
+  GLVIDEO_ATLAS_COPY_T copy = { atlas, state, mem };
+  gint64 start = g_get_monotonic_time ();
+
+  gst_gl_context_thread_add (mem->mem.context, atlas_copy_cb, &copy);
+
+  gint64 elapsed = g_get_monotonic_time () - start;
+  g_mutex_lock (&atlas->lock);
+  atlas->copies++;
+  atlas->copy_time += elapsed;
+  atlas->copy_time_max = MAX (atlas->copy_time_max, elapsed);
+  g_mutex_unlock (&atlas->lock);
+}
+
+static void
+atlas_delete (GstGLContext * context, gpointer data)
+{
+  GLVIDEO_ATLAS_T *atlas = (GLVIDEO_ATLAS_T *) data;
+  const GstGLFuncs *gl = context->gl_vtable;
+
+  // fences are shared like textures
+  for (guint i=0; i < atlas->tiles->len; i++) {
+    GLVIDEO_ATLAS_TILE_T *tile = &g_array_index (atlas->tiles, GLVIDEO_ATLAS_TILE_T, i);
+    if (tile->sync) {
+      gl->DeleteSync (tile->sync);
+    }
+  }
+  glDeleteTextures (1, &atlas->tex);
+  g_atomic_int_add (&live_gl_objects, -1);
+}
+
+static void
+atlas_unref (GLVIDEO_ATLAS_T * atlas)
+{
+  if (!g_atomic_int_dec_and_test (&atlas->refcount)) {
+    return;
+  }
+  if (atlas->context) {
+    gst_gl_context_thread_add (atlas->context, atlas_delete, atlas);
+    gst_object_unref (atlas->context);
+  }
+  g_array_free (atlas->tiles, TRUE);
+  g_mutex_clear (&atlas->lock);
+  g_free (atlas);
+}
+
+static void
+atlas_delete_fbo (GstGLContext * context, gpointer data)
+{
+  GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *) data;
+  glDeleteFramebuffers (1, &state->atlas_fbo);
+}
+
+// called by close, once the pipeline has stopped
+static void
+atlas_detach (GLVIDEO_STATE_T * state)
+{
+  g_mutex_lock (&state->buffer_lock);
+  GLVIDEO_ATLAS_T *atlas = state->atlas;
+  state->atlas = NULL;
+  g_mutex_unlock (&state->buffer_lock);
+
+  if (atlas) {
+    g_mutex_lock (&atlas->lock);
+    for (guint i=0; i < atlas->tiles->len; i++) {
+      GLVIDEO_ATLAS_TILE_T *tile = &g_array_index (atlas->tiles, GLVIDEO_ATLAS_TILE_T, i);
+      if (tile->state == state) {
+        tile->state = NULL;
+      }
+    }
+    g_mutex_unlock (&atlas->lock);
+    atlas_unref (atlas);
+  }
+
+  if (state->atlas_fbo) {
+    gst_gl_context_thread_add (state->atlas_fbo_context, atlas_delete_fbo, state);
+    gst_object_unref (state->atlas_fbo_context);
+    state->atlas_fbo = 0;
+    state->atlas_fbo_context = NULL;
+    g_atomic_int_add (&live_gl_objects, -1);
+  }
+}
+
 static void
 handle_buffer (GLVIDEO_STATE_T * state, GstBuffer * buffer)
 {
   g_mutex_lock (&state->buffer_lock);
   if (unlikely (state->next_buffer != NULL)) {
+    // the sketch didn't get to read this frame
     gst_buffer_unref (state->next_buffer);
     state->next_buffer = NULL;
+    state->frames_missed++;
   }
   state->next_tex = 0;
 
@@ -109,9 +501,40 @@ handle_buffer (GLVIDEO_STATE_T * state, GstBuffer * buffer)
     return;
   }
 
-  state->next_buffer = gst_buffer_ref (buffer);
-  state->next_tex = ((GstGLMemory *) mem)->tex_id;
+  GLVIDEO_ATLAS_T *atlas = state->atlas;
+  if (atlas) {
+    // the frame gets copied into the atlas below, and isn't kept around
+    g_atomic_int_inc (&atlas->refcount);
+  } else {
+    state->next_buffer = gst_buffer_ref (buffer);
+    state->next_tex = ((GstGLMemory *) mem)->tex_id;
+    // keep track of the distinct textures we've been handed for the memory accounting
+    if (g_hash_table_add (state->textures, GUINT_TO_POINTER (state->next_tex))) {
+      g_atomic_int_inc (&live_textures);
+    }
+  }
+  state->frames_produced++;
+  state->next_since = g_get_monotonic_time ();
+  state->next_pts = GST_BUFFER_PTS (buffer);
+  state->frame_serial++;
+  guint64 serial = state->frame_serial;
+  g_cond_broadcast (&state->frame_cond);
+  publish_frame_desc (state);
   g_mutex_unlock (&state->buffer_lock);
+
+  if (atlas) {
+    atlas_copy_frame (atlas, state, (GstGLMemory *) mem);
+    atlas_unref (atlas);
+  }
+
+  if (serial == 1) {
+    gint64 latency = g_get_monotonic_time () - state->open_time;
+    g_mutex_lock (&resource_lock);
+    first_frames++;
+    first_frame_total += latency;
+    first_frame_max = MAX (first_frame_max, latency);
+    g_mutex_unlock (&resource_lock);
+  }
 }
 
 static void
@@ -128,6 +551,11 @@ buffers_cb (GstElement * fakesink, GstBuffer * buffer, GstPad * pad,
 {
   GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *) user_data;
   handle_buffer (state, buffer);
+
+  // only while playing, since the cues are scheduled on the pipeline clock
+  g_mutex_lock (&state->buffer_lock);
+  schedule_cues (state, buffer);
+  g_mutex_unlock (&state->buffer_lock);
 }
 
 static GstPadProbeReturn
@@ -139,19 +567,40 @@ events_cb (GstPad * pad, GstPadProbeInfo * probe_info, gpointer user_data)
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_CAPS:
     {
-      if (state->caps) {
-        gst_caps_unref (state->caps);
-        state->caps = NULL;
+      GstCaps *caps = NULL;
+      gst_event_parse_caps (event, &caps);
+      int width = 0;
+      int height = 0;
+      if (caps) {
+        gst_caps_ref (caps);
+        const GstStructure *str = gst_caps_get_structure (caps, 0);
+        gst_structure_get_int (str, "width", &width);
+        gst_structure_get_int (str, "height", &height);
       }
-      gst_event_parse_caps (event, &state->caps);
+      // textures from before are going to be released
+      g_mutex_lock (&state->buffer_lock);
       if (state->caps) {
-        // XXX: remove
-        gchar * temp = gst_caps_to_string (state->caps);
-        fprintf (stdout, "Final caps: %s\n", temp);
-        fflush (stdout);
-        g_free (temp);
-        gst_caps_ref (state->caps);
+        gst_caps_unref (state->caps);
       }
+      // the adaptive quality controller reads this on the main loop thread
+      state->caps = caps;
+      g_atomic_int_add (&live_textures, -(gint) g_hash_table_size (state->textures));
+      g_hash_table_remove_all (state->textures);
+      state->width = width;
+      state->height = height;
+      publish_frame_desc (state);
+      g_mutex_unlock (&state->buffer_lock);
+      break;
+    }
+    case GST_EVENT_SEGMENT:
+    {
+      const GstSegment *segment;
+      gst_event_parse_segment (event, &segment);
+      // after seeking or looping, cues fire again from the segment's start
+      g_mutex_lock (&state->buffer_lock);
+      gst_segment_copy_into (segment, &state->segment);
+      reset_cues (state, segment->time);
+      g_mutex_unlock (&state->buffer_lock);
       break;
     }
     // this is handled in eos_cb
@@ -164,6 +613,84 @@ events_cb (GstPad * pad, GstPadProbeInfo * probe_info, gpointer user_data)
   return GST_PAD_PROBE_OK;
 }
 
+static gboolean
+handle_local_context_query (GLVIDEO_STATE_T * state, GstQuery * query)
+{
+  const gchar *context_type;
+  GstContext *context, *old_context;
+  GstStructure *s;
+
+  if (!state->shared_context) {
+    // let the GL elements create their own
+    return FALSE;
+  }
+
+  gst_query_parse_context_type (query, &context_type);
+  if (g_strcmp0 (context_type, "gst.gl.local_context") != 0) {
+    return FALSE;
+  }
+
+  // hand out the shared context, so that no additional GL thread gets created
+  gst_query_parse_context (query, &old_context);
+  if (old_context) {
+    context = gst_context_copy (old_context);
+  } else {
+    context = gst_context_new ("gst.gl.local_context", FALSE);
+  }
+  s = gst_context_writable_structure (context);
+  gst_structure_set (s, "context", GST_TYPE_GL_CONTEXT, state->shared_context,
+      NULL);
+  gst_query_set_context (query, context);
+  gst_context_unref (context);
+  return TRUE;
+}
+
+static gboolean
+handle_allocation_query (GLVIDEO_STATE_T * state, GstQuery * query)
+{
+  GstCaps *caps;
+  gboolean need_pool;
+  GstVideoInfo info;
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+
+  if (state->pool_max_buffers == 0 || !state->shared_context) {
+    // leave it to the upstream elements
+    return FALSE;
+  }
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+  if (!caps || !gst_video_info_from_caps (&info, caps)) {
+    return FALSE;
+  }
+  if (!gst_caps_features_contains (gst_caps_get_features (caps, 0),
+          GST_CAPS_FEATURE_MEMORY_GL_MEMORY)) {
+    return FALSE;
+  }
+
+  // propose a pool of fixed size, this bounds the number of textures per pipeline
+  if (need_pool) {
+    pool = gst_gl_buffer_pool_new (state->shared_context);
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, info.size,
+        state->pool_min_buffers, state->pool_max_buffers);
+    gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      g_printerr ("GLVideo: Could not configure buffer pool\n");
+      gst_object_unref (pool);
+      return FALSE;
+    }
+  }
+
+  gst_query_add_allocation_pool (query, pool, info.size,
+      state->pool_min_buffers, state->pool_max_buffers);
+  gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  if (pool) {
+    gst_object_unref (pool);
+  }
+  return TRUE;
+}
+
 static GstPadProbeReturn
 query_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
 {
@@ -173,6 +700,8 @@ query_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
   switch (GST_QUERY_TYPE (query)) {
     case GST_QUERY_CONTEXT:
     {
+      if (handle_local_context_query (state, query))
+        return GST_PAD_PROBE_HANDLED;
 #if GST_VERSION_MAJOR <= 1 && GST_VERSION_MINOR <= 10
       if (gst_gl_handle_context_query (state->pipeline, query,
               (GstGLDisplay **) & gst_display,
@@ -186,6 +715,12 @@ query_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
 #endif
       break;
     }
+    case GST_QUERY_ALLOCATION:
+    {
+      if (handle_allocation_query (state, query))
+        return GST_PAD_PROBE_HANDLED;
+      break;
+    }
     default:
       break;
   }
@@ -217,15 +752,93 @@ static void
 buffering_cb (GstBus * bus, GstMessage * msg, GLVIDEO_STATE_T * state)
 {
   gint percent;
+  GstBufferingMode mode;
+  gint avg_in, avg_out;
+  gint64 buffering_left;
+  gint64 now = g_get_monotonic_time ();
+  GstState target = GST_STATE_VOID_PENDING;
 
   gst_message_parse_buffering (msg, &percent);
-  if (percent < 100) {
-    gst_element_set_state (state->pipeline, GST_STATE_PAUSED);
+  gst_message_parse_buffering_stats (msg, &mode, &avg_in, &avg_out, &buffering_left);
+
+  g_mutex_lock (&state->buffer_lock);
+  state->buffering_percent = percent;
+  state->buffering_avg_in = avg_in;
+  state->buffering_avg_out = avg_out;
+  state->buffering_left = buffering_left;
+
+  // pause below the low watermark, and only resume once the high watermark
+  // is reached, rather than toggling between the two around 100%
+  if (!state->buffering && percent < state->buffering_low) {
     state->buffering = true;
-  } else {
-    gst_element_set_state (state->pipeline, GST_STATE_PLAYING);
+    state->buffering_events++;
+    state->buffering_since = now;
+    if (state->playing_requested) {
+      target = GST_STATE_PAUSED;
+    }
+  } else if (state->buffering && state->buffering_high <= percent) {
     state->buffering = false;
+    state->buffering_time += now - state->buffering_since;
+    if (state->playing_requested) {
+      target = GST_STATE_PLAYING;
+    }
+  }
+  g_mutex_unlock (&state->buffer_lock);
+
+  // not holding buffer_lock, since the sink might be waiting on it
+  if (target != GST_STATE_VOID_PENDING) {
+    gst_element_set_state (state->pipeline, target);
+  }
+}
+
+static gboolean
+invoke_cb (gpointer user_data)
+{
+  GLVIDEO_INVOKE_T *invoke = (GLVIDEO_INVOKE_T *) user_data;
+
+  invoke->func (invoke->data);
+
+  g_mutex_lock (&invoke->lock);
+  invoke->done = true;
+  g_cond_signal (&invoke->cond);
+  g_mutex_unlock (&invoke->lock);
+  return G_SOURCE_REMOVE;
+}
+
+// runs func on the main loop thread, and waits for it to return
+static void
+invoke_on_main_loop (GSourceFunc func, gpointer data)
+{
+  GLVIDEO_INVOKE_T invoke;
+
+  invoke.func = func;
+  invoke.data = data;
+  invoke.done = false;
+  g_mutex_init (&invoke.lock);
+  g_cond_init (&invoke.cond);
+
+  // this calls invoke_cb directly when already on the main loop thread
+  g_main_context_invoke (NULL, invoke_cb, &invoke);
+
+  g_mutex_lock (&invoke.lock);
+  while (!invoke.done) {
+    g_cond_wait (&invoke.cond, &invoke.lock);
   }
+  g_mutex_unlock (&invoke.lock);
+
+  g_cond_clear (&invoke.cond);
+  g_mutex_clear (&invoke.lock);
+}
+
+static GstSeekFlags
+get_trick_flags (GLVIDEO_STATE_T * state)
+{
+  GstSeekFlags trick_flags;
+
+  g_mutex_lock (&state->buffer_lock);
+  trick_flags = state->trick_flags;
+  g_mutex_unlock (&state->buffer_lock);
+  return trick_flags;
 }
 
 static void
@@ -235,72 +848,365 @@ eos_cb (GstBus * bus, GstMessage * msg, GLVIDEO_STATE_T * state)
     if (state->looping) {
       GstEvent *event;
       event = gst_event_new_seek (state->rate,
-        GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
+        GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | get_trick_flags (state),
         GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_SET, GST_CLOCK_TIME_NONE);
       if (!gst_element_send_event (state->vsink, event)) {
         g_printerr ("GLVideo: Error rewinding video\n");
       }
     } else {
+      g_mutex_lock (&state->buffer_lock);
+      state->playing_requested = false;
+      publish_frame_desc (state);
+      g_mutex_unlock (&state->buffer_lock);
       gst_element_set_state (state->pipeline, GST_STATE_PAUSED);
     }
   }
 }
 
-static gboolean
-init_pipeline_player (GLVIDEO_STATE_T * state, const gchar * pipeline)
+// adaptive quality controller
+#define GLVIDEO_QUALITY_LEVELS 4
+#define GLVIDEO_ADAPTIVE_INTERVAL 500     // ms
+#define GLVIDEO_ADAPTIVE_COOLDOWN 2       // intervals
+#define GLVIDEO_ADAPTIVE_HEADROOM 6       // intervals
+#define GLVIDEO_ADAPTIVE_MAX_LATENESS 40  // ms
+#define GLVIDEO_ADAPTIVE_MAX_LATENCY 100  // ms
+
+static void
+qos_cb (GstBus * bus, GstMessage * msg, GLVIDEO_STATE_T * state)
 {
-  const char pipeline_vsink[] = "glupload name=glup ! glcolorconvert ! capsfilter name=filter ! fakesink name=vsink";
-  char *pipeline_final = calloc (strlen (pipeline) + 3 + strlen (pipeline_vsink) + 1, sizeof (char));
+  gint64 jitter;
 
-  char *has_empty_videosink = strstr (pipeline, "video-sink=\"\"");
-  if (has_empty_videosink) {
-    // fill in our sink as the pipeline's (playbin's) video-sink property
-    strncat (pipeline_final, pipeline, has_empty_videosink-pipeline+12);
-    strcat (pipeline_final, pipeline_vsink);
-    strcat (pipeline_final, has_empty_videosink+12);
-  } else {
-    // append our sink at the end
-    strcat (pipeline_final, pipeline);
-    strcat (pipeline_final, " ! ");
-    strcat (pipeline_final, pipeline_vsink);
+  // frames dropped on purpose by the adaptive quality controller don't count
+  if (state->videorate && GST_MESSAGE_SRC (msg) == GST_OBJECT (state->videorate)) {
+    return;
   }
 
-  GError *error = NULL;
-  state->pipeline = gst_parse_launch (pipeline_final, &error);
-  if (error) {
-    g_printerr ("Could not parse pipeline %s: %s\n", pipeline_final, error->message);
-    free (pipeline_final);
-    g_error_free (error);
-    return FALSE;
-  } else {
-    free (pipeline_final);
-  }
+  // posted by the sink as well as by decoders for every frame they drop
+  gst_message_parse_qos_values (msg, &jitter, NULL, NULL);
 
-  // look for video sink elements
-  GstElement *glup = gst_bin_get_by_name (GST_BIN (state->pipeline), "glup");
-  GstElement *capsfilter = gst_bin_get_by_name (GST_BIN (state->pipeline), "filter");
-  GstElement *vsink = gst_bin_get_by_name (GST_BIN (state->pipeline), "vsink");
+  g_mutex_lock (&state->buffer_lock);
+  state->qos_events++;
+  state->max_lateness = MAX (state->max_lateness, jitter);
+  g_mutex_unlock (&state->buffer_lock);
+}
 
-  // if they're not in the main pipeline, look in its video-sink bin
-  if (!glup) {
-    GstElement *videosink;
-    g_object_get (state->pipeline, "video-sink", &videosink, NULL);
-    glup = gst_bin_get_by_name (GST_BIN (videosink), "glup");
-    capsfilter = gst_bin_get_by_name (GST_BIN (videosink), "filter");
-    vsink = gst_bin_get_by_name (GST_BIN (videosink), "vsink");
+// this runs on the main loop thread
+static void
+apply_quality (GLVIDEO_STATE_T * state, int level)
+{
+  // remember the native format before stepping down for the first time
+  g_mutex_lock (&state->buffer_lock);
+  if (state->quality == 0 && state->caps) {
+    const GstStructure *str = gst_caps_get_structure (state->caps, 0);
+    int num = 0;
+    int denom = 1;
+    gst_structure_get_int (str, "width", &state->native_width);
+    gst_structure_get_int (str, "height", &state->native_height);
+    gst_structure_get_fraction (str, "framerate", &num, &denom);
+    state->native_fps = (0 < denom) ? num / denom : 0;
   }
+  // the size of videos in an atlas is fixed by their rectangle
+  bool in_atlas = (state->atlas != NULL);
+  g_mutex_unlock (&state->buffer_lock);
 
-  g_object_set (capsfilter, "caps",
-      gst_caps_from_string ("video/x-raw(memory:GLMemory),format=RGBA,texture-target=2D"), NULL);
-  g_object_set (vsink, "silent", TRUE, "qos", TRUE,
-      "enable-last-sample", FALSE, "max-lateness", 20 * GST_MSECOND,
-      "signal-handoffs", TRUE, NULL);
-
-  // handle NO_SYNC flag
-  if ((state->flags & gohai_glvideo_GLVideo_NO_SYNC)) {
-    g_object_set (vsink, "sync", FALSE, NULL);
-  } else {
-    g_object_set (vsink, "sync", TRUE, NULL);
+  // 1 and up: half the resolution, done by glcolorscale if there is one
+  if (state->native_width && (state->flags & gohai_glvideo_GLVideo_SCALABLE) && !in_atlas) {
+    GstCaps *caps = gst_caps_from_string ("video/x-raw(memory:GLMemory),format=RGBA,texture-target=2D");
+    if (1 <= level) {
+      gst_caps_set_simple (caps, "width", G_TYPE_INT, state->native_width / 2,
+          "height", G_TYPE_INT, state->native_height / 2, NULL);
+    }
+    g_object_set (state->filter, "caps", caps, NULL);
+    gst_caps_unref (caps);
+  }
+
+  if (state->videorate) {
+    // 2: half, 3: a quarter of the capture framerate
+    int max_rate = G_MAXINT;
+    if (2 <= level && state->native_fps) {
+      max_rate = MAX (state->native_fps / (level == 2 ? 2 : 4), 1);
+    }
+    g_object_set (state->videorate, "max-rate", max_rate, NULL);
+  } else {
+    // 2: skip non-reference frames, 3: only decode keyframes
+    GstSeekFlags trick_flags = 0;
+    if (level == 2) {
+      trick_flags = GST_SEEK_FLAG_TRICKMODE;
+    } else if (level == 3) {
+      trick_flags = GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_KEY_UNITS;
+    }
+
+    gint64 pos;
+    if (trick_flags != get_trick_flags (state) &&
+        gst_element_query_position (state->pipeline, GST_FORMAT_TIME, &pos)) {
+      g_mutex_lock (&state->buffer_lock);
+      state->trick_flags = trick_flags;
+      g_mutex_unlock (&state->buffer_lock);
+      // trick modes only take effect with a seek, not holding buffer_lock
+      GstEvent *event = gst_event_new_seek (state->rate,
+        GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | trick_flags,
+        GST_SEEK_TYPE_SET, (0 < state->rate) ? pos : 0,
+        GST_SEEK_TYPE_SET, (0 < state->rate) ? GST_CLOCK_TIME_NONE : pos);
+      gst_element_send_event (state->vsink, event);
+    }
+  }
+
+  g_mutex_lock (&state->buffer_lock);
+  if (state->quality < level) {
+    state->quality_down++;
+  } else if (level < state->quality) {
+    state->quality_up++;
+  }
+  state->quality = level;
+  g_mutex_unlock (&state->buffer_lock);
+  // give the pipeline time to settle before judging again
+  state->cooldown = GLVIDEO_ADAPTIVE_COOLDOWN;
+  state->headroom = 0;
+}
+
+static gboolean
+adaptive_cb (gpointer user_data)
+{
+  GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *) user_data;
+  int produced, missed, consumed, qos_events, sketch_frames;
+  gint64 lateness;
+  bool playing_requested;
+
+  g_mutex_lock (&state->buffer_lock);
+  sketch_frames = state->sketch_frame - state->sketch_frame_prev;
+  state->sketch_frame_prev = state->sketch_frame;
+  produced = state->frames_produced;
+  missed = state->frames_missed;
+  consumed = state->frames_consumed;
+  qos_events = state->qos_events;
+  lateness = state->max_lateness;
+  state->avg_consume_latency = (consumed) ? state->consume_latency / consumed : 0;
+  state->last_lateness = lateness;
+  state->total_missed += missed;
+  state->total_qos_events += qos_events;
+  state->frames_produced = 0;
+  state->frames_missed = 0;
+  state->frames_consumed = 0;
+  state->consume_latency = 0;
+  state->qos_events = 0;
+  state->max_lateness = 0;
+  playing_requested = state->playing_requested;
+  g_mutex_unlock (&state->buffer_lock);
+
+  if (!playing_requested || (produced == 0 && qos_events == 0)) {
+    return G_SOURCE_CONTINUE;
+  }
+  if (0 < state->cooldown) {
+    state->cooldown--;
+    return G_SOURCE_CONTINUE;
+  }
+
+  // frames arriving faster than the sketch draws can't all be read, so
+  // only count the misses beyond that
+  int unreadable = MAX (produced - sketch_frames, 0);
+  int excess_missed = missed - unreadable;
+
+  // the sketch doesn't get to read every fourth frame it had time for, the
+  // pipeline drops frames, or they wait too long before being read
+  bool overloaded = (produced < excess_missed * 4) ||
+                    (produced + qos_events < qos_events * 10) ||
+                    (GLVIDEO_ADAPTIVE_MAX_LATENESS * GST_MSECOND < lateness) ||
+                    (GLVIDEO_ADAPTIVE_MAX_LATENCY * 1000 < state->avg_consume_latency);
+
+  if (overloaded) {
+    if (state->quality < GLVIDEO_QUALITY_LEVELS - 1) {
+      apply_quality (state, state->quality + 1);
+    }
+  } else if (excess_missed <= 0 && qos_events == 0) {
+    // step back up only after a while without any dropped frames
+    state->headroom++;
+    if (GLVIDEO_ADAPTIVE_HEADROOM <= state->headroom && 0 < state->quality) {
+      apply_quality (state, state->quality - 1);
+    }
+  } else {
+    state->headroom = 0;
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+adaptive_start_cb (gpointer user_data)
+{
+  GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *) user_data;
+
+  if (!state->adaptive_source) {
+    state->adaptive_source = g_timeout_add (GLVIDEO_ADAPTIVE_INTERVAL, adaptive_cb, state);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+adaptive_stop_cb (gpointer user_data)
+{
+  GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *) user_data;
+
+  // adaptive_cb can't be running at the same time, since it's on this thread
+  if (state->adaptive_source) {
+    g_source_remove (state->adaptive_source);
+    state->adaptive_source = 0;
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+adaptive_disable_cb (gpointer user_data)
+{
+  GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *) user_data;
+
+  adaptive_stop_cb (state);
+  if (state->quality != 0) {
+    apply_quality (state, 0);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static void
+set_int_property (GObject * object, const gchar * name, int value)
+{
+  GParamSpec *pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (object), name);
+  if (!pspec) {
+    return;
+  }
+  // decoders don't agree on the type
+  if (pspec->value_type == G_TYPE_INT) {
+    g_object_set (object, name, value, NULL);
+  } else if (pspec->value_type == G_TYPE_UINT) {
+    g_object_set (object, name, (guint) value, NULL);
+  }
+}
+
+static void
+configure_element (GstElement * element, GLVIDEO_STATE_T * state)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  if (!factory) {
+    return;
+  }
+
+  if (gst_element_factory_list_is_type (factory,
+      GST_ELEMENT_FACTORY_TYPE_DECODER | GST_ELEMENT_FACTORY_TYPE_MEDIA_VIDEO)) {
+    g_mutex_lock (&state->buffer_lock);
+    g_free (state->decoder);
+    state->decoder = g_strdup (GST_OBJECT_NAME (factory));
+    g_mutex_unlock (&state->buffer_lock);
+
+    if (decoder_threads) {
+      // avdec_* call it max-threads, vpxdec and others threads
+      set_int_property (G_OBJECT (element), "max-threads", decoder_threads);
+      set_int_property (G_OBJECT (element), "threads", decoder_threads);
+    }
+  } else if (decoder_queue_time &&
+      (!strcmp (GST_OBJECT_NAME (factory), "decodebin") ||
+       !strcmp (GST_OBJECT_NAME (factory), "uridecodebin"))) {
+    // decodebin resets the limits of its multiqueue as streams get added,
+    // so set them on the bin itself, which passes them on
+    g_object_set (element, "max-size-time", (guint64) decoder_queue_time,
+        "max-size-buffers", 0, "max-size-bytes", 0, NULL);
+  }
+}
+
+static void
+deep_element_added_cb (GstBin * bin, GstBin * sub_bin, GstElement * element,
+    GLVIDEO_STATE_T * state)
+{
+  configure_element (element, state);
+}
+
+static void
+element_added_cb (GstBin * bin, GstElement * element, GLVIDEO_STATE_T * state)
+{
+  configure_element (element, state);
+  // before GStreamer 1.10, follow nested bins by hand
+  if (GST_IS_BIN (element)) {
+    g_signal_connect (element, "element-added",
+        G_CALLBACK (element_added_cb), state);
+  }
+}
+
+static GstPadProbeReturn
+analysis_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *) user_data;
+
+  // unlocked, analysis_process checks again
+  if (!state->analysis.enabled) {
+    return GST_PAD_PROBE_OK;
+  }
+  // frames before they are uploaded, on the streaming thread
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  analysis_process (&state->analysis, GST_PAD_PROBE_INFO_BUFFER (info), caps);
+  if (caps) {
+    gst_caps_unref (caps);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+init_pipeline_player (GLVIDEO_STATE_T * state, const gchar * pipeline)
+{
+  // glcolorscale costs an extra pass on the GPU, so only add it when asked to
+  const char *pipeline_vsink = (state->flags & gohai_glvideo_GLVideo_SCALABLE) ?
+    "glupload name=glup ! glcolorconvert ! glcolorscale ! capsfilter name=filter ! fakesink name=vsink" :
+    "glupload name=glup ! glcolorconvert ! capsfilter name=filter ! fakesink name=vsink";
+  char *pipeline_final = calloc (strlen (pipeline) + 3 + strlen (pipeline_vsink) + 1, sizeof (char));
+
+  char *has_empty_videosink = strstr (pipeline, "video-sink=\"\"");
+  if (has_empty_videosink) {
+    // fill in our sink as the pipeline's (playbin's) video-sink property
+    strncat (pipeline_final, pipeline, has_empty_videosink-pipeline+12);
+    strcat (pipeline_final, pipeline_vsink);
+    strcat (pipeline_final, has_empty_videosink+12);
+  } else {
+    // append our sink at the end
+    strcat (pipeline_final, pipeline);
+    strcat (pipeline_final, " ! ");
+    strcat (pipeline_final, pipeline_vsink);
+  }
+
+  GError *error = NULL;
+  state->pipeline = gst_parse_launch (pipeline_final, &error);
+  if (error) {
+    g_printerr ("Could not parse pipeline %s: %s\n", pipeline_final, error->message);
+    free (pipeline_final);
+    g_error_free (error);
+    return FALSE;
+  } else {
+    free (pipeline_final);
+  }
+
+  // look for video sink elements
+  GstElement *glup = gst_bin_get_by_name (GST_BIN (state->pipeline), "glup");
+  GstElement *capsfilter = gst_bin_get_by_name (GST_BIN (state->pipeline), "filter");
+  GstElement *vsink = gst_bin_get_by_name (GST_BIN (state->pipeline), "vsink");
+
+  // if they're not in the main pipeline, look in its video-sink bin
+  if (!glup) {
+    GstElement *videosink;
+    g_object_get (state->pipeline, "video-sink", &videosink, NULL);
+    glup = gst_bin_get_by_name (GST_BIN (videosink), "glup");
+    capsfilter = gst_bin_get_by_name (GST_BIN (videosink), "filter");
+    vsink = gst_bin_get_by_name (GST_BIN (videosink), "vsink");
+    gst_object_unref (videosink);
+  }
+
+  GstCaps *gl_caps = gst_caps_from_string ("video/x-raw(memory:GLMemory),format=RGBA,texture-target=2D");
+  g_object_set (capsfilter, "caps", gl_caps, NULL);
+  gst_caps_unref (gl_caps);
+  g_object_set (vsink, "silent", TRUE, "qos", TRUE,
+      "enable-last-sample", FALSE, "max-lateness", 20 * GST_MSECOND,
+      "signal-handoffs", TRUE, NULL);
+
+  // handle NO_SYNC flag
+  if ((state->flags & gohai_glvideo_GLVideo_NO_SYNC)) {
+    g_object_set (vsink, "sync", FALSE, NULL);
+  } else {
+    g_object_set (vsink, "sync", TRUE, NULL);
   }
 
   g_signal_connect (vsink, "preroll-handoff", G_CALLBACK (preroll_cb), state);
@@ -313,9 +1219,14 @@ init_pipeline_player (GLVIDEO_STATE_T * state, const gchar * pipeline)
       NULL);
   gst_object_unref (pad);
 
-  // this seems to be necessary, otherwise close will complain about
-  // gst_object_unref with object == NULL
-  state->vsink = gst_object_ref (vsink);
+  pad = gst_element_get_static_pad (glup, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, analysis_cb, state, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (glup);
+
+  // keep the references gst_bin_get_by_name gave us
+  state->vsink = vsink;
+  state->filter = capsfilter;
   return TRUE;
 }
 
@@ -325,21 +1236,56 @@ init_device_player (GLVIDEO_STATE_T * state, GstElement * src, const char * caps
   state->pipeline = gst_pipeline_new (NULL);
 
   GstElement *caps_src = gst_element_factory_make ("capsfilter", NULL);
+  // only drops frames once the adaptive quality controller sets max-rate
+  GstElement *videorate = gst_element_factory_make ("videorate", NULL);
   GstElement *glup = gst_element_factory_make ("glupload", "glup");
   GstElement *glcolorconv = gst_element_factory_make ("glcolorconvert", NULL);
   GstElement *capsfilter = gst_element_factory_make ("capsfilter", "filter");
   GstElement *vsink = gst_element_factory_make ("fakesink", "vsink");
 
-  gst_bin_add_many (GST_BIN (state->pipeline), src, caps_src, glup, glcolorconv, capsfilter, vsink, NULL);
-  gst_element_link_many (src, caps_src, glup, glcolorconv, capsfilter, vsink, NULL);
+  g_object_set (videorate, "drop-only", TRUE, NULL);
+
+  gst_bin_add_many (GST_BIN (state->pipeline), src, caps_src, videorate, glup, glcolorconv, capsfilter, vsink, NULL);
+  if ((state->flags & gohai_glvideo_GLVideo_SCALABLE)) {
+    // see init_pipeline_player
+    GstElement *glcolorscale = gst_element_factory_make ("glcolorscale", NULL);
+    gst_bin_add (GST_BIN (state->pipeline), glcolorscale);
+    gst_element_link_many (videorate, glup, glcolorconv, glcolorscale, capsfilter, vsink, NULL);
+  } else {
+    gst_element_link_many (videorate, glup, glcolorconv, capsfilter, vsink, NULL);
+  }
+
+  if (g_str_has_prefix (caps, "image/jpeg")) {
+    // see negotiateDeviceCaps, prefer libav's decoder, since it can use multiple threads
+    GstElement *jpegdec = gst_element_factory_make ("avdec_mjpeg", NULL);
+    if (jpegdec) {
+      if (decoder_threads) {
+        set_int_property (G_OBJECT (jpegdec), "max-threads", decoder_threads);
+      }
+    } else {
+      jpegdec = gst_element_factory_make ("jpegdec", NULL);
+    }
+    if (!jpegdec) {
+      g_printerr ("GLVideo: Could not create a JPEG decoder\n");
+      // the pipeline is freed by createGlPipeline
+      return FALSE;
+    }
+    state->decoder = g_strdup (GST_OBJECT_NAME (gst_element_get_factory (jpegdec)));
+    gst_bin_add (GST_BIN (state->pipeline), jpegdec);
+    gst_element_link_many (src, caps_src, jpegdec, videorate, NULL);
+  } else {
+    gst_element_link_many (src, caps_src, videorate, NULL);
+  }
 
-  g_object_set (caps_src, "caps",
-      gst_caps_from_string (caps), NULL);
+  GstCaps *src_caps = gst_caps_from_string (caps);
+  g_object_set (caps_src, "caps", src_caps, NULL);
+  gst_caps_unref (src_caps);
 
   // the following is the same as in init_pipeline_player
 
-  g_object_set (capsfilter, "caps",
-      gst_caps_from_string ("video/x-raw(memory:GLMemory),format=RGBA,texture-target=2D"), NULL);
+  GstCaps *gl_caps = gst_caps_from_string ("video/x-raw(memory:GLMemory),format=RGBA,texture-target=2D");
+  g_object_set (capsfilter, "caps", gl_caps, NULL);
+  gst_caps_unref (gl_caps);
   g_object_set (vsink, "silent", TRUE, "qos", TRUE,
       "enable-last-sample", FALSE, "max-lateness", 20 * GST_MSECOND,
       "signal-handoffs", TRUE, NULL);
@@ -361,13 +1307,200 @@ init_device_player (GLVIDEO_STATE_T * state, GstElement * src, const char * caps
       NULL);
   gst_object_unref (pad);
 
+  pad = gst_element_get_static_pad (glup, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, analysis_cb, state, NULL);
+  gst_object_unref (pad);
+
   // this seems to be necessary, otherwise close will complain about
   // gst_object_unref with object == NULL
   state->vsink = gst_object_ref (vsink);
+  state->filter = gst_object_ref (capsfilter);
+  state->videorate = gst_object_ref (videorate);
 
   return TRUE;
 }
 
+static void
+acquire_gl_contexts (GLVIDEO_STATE_T * state)
+{
+  g_mutex_lock (&context_lock);
+
+  // wrap Processing's context only once, and share the display with all pipelines
+  if (!wrapped_context) {
+#ifdef __APPLE__
+    gst_display = gst_gl_display_new ();
+    wrapped_context =
+      gst_gl_context_new_wrapped (GST_GL_DISPLAY (gst_display),
+      context, GST_GL_PLATFORM_CGL, gst_gl_context_get_current_gl_api (GST_GL_PLATFORM_CGL, NULL, NULL));
+#elif GLES2
+    gst_display = gst_gl_display_egl_new_with_egl_display (display);
+    wrapped_context =
+      gst_gl_context_new_wrapped (GST_GL_DISPLAY (gst_display),
+      (guintptr) context, GST_GL_PLATFORM_EGL, GST_GL_API_GLES2);
+#else
+    gst_display = gst_gl_display_x11_new_with_display (display);
+    wrapped_context =
+      gst_gl_context_new_wrapped (GST_GL_DISPLAY (gst_display),
+      (guintptr) context, GST_GL_PLATFORM_GLX, GST_GL_API_OPENGL);
+#endif
+  }
+  state->gl_context = gst_object_ref (wrapped_context);
+
+  // pick the least used of the shared contexts GStreamer runs its GL elements on
+  state->shared_context = NULL;
+  state->shared_context_idx = -1;
+  if (0 < num_shared_contexts) {
+    int idx = 0;
+    for (int i=1; i < num_shared_contexts; i++) {
+      if (shared_context_users[i] < shared_context_users[idx]) {
+        idx = i;
+      }
+    }
+
+    if (!shared_contexts[idx]) {
+      GError *error = NULL;
+      GstGLContext *shared = gst_gl_context_new (GST_GL_DISPLAY (gst_display));
+      if (gst_gl_context_create (shared, wrapped_context, &error)) {
+        // this makes it also available to elements looking up contexts by display
+        gst_gl_display_add_context (GST_GL_DISPLAY (gst_display), shared);
+        shared_contexts[idx] = shared;
+      } else {
+        g_printerr ("GLVideo: Could not create shared GL context: %s\n",
+          error ? error->message : "unknown error");
+        g_clear_error (&error);
+        gst_object_unref (shared);
+      }
+    }
+
+    if (shared_contexts[idx]) {
+      state->shared_context = gst_object_ref (shared_contexts[idx]);
+      state->shared_context_idx = idx;
+      shared_context_users[idx]++;
+    }
+  }
+
+  context_users++;
+  g_mutex_unlock (&context_lock);
+}
+
+static void
+release_gl_contexts (GLVIDEO_STATE_T * state)
+{
+  g_mutex_lock (&context_lock);
+
+  if (state->shared_context) {
+    gst_object_unref (state->shared_context);
+    state->shared_context = NULL;
+    shared_context_users[state->shared_context_idx]--;
+  }
+  if (state->gl_context) {
+    gst_object_unref (state->gl_context);
+    state->gl_context = NULL;
+  }
+
+  // tear everything down once the last pipeline is gone, this also stops the GL threads
+  context_users--;
+  if (context_users == 0) {
+    for (int i=0; i < GLVIDEO_MAX_SHARED_CONTEXTS; i++) {
+      if (shared_contexts[i]) {
+        gst_object_unref (shared_contexts[i]);
+        shared_contexts[i] = NULL;
+      }
+      shared_context_users[i] = 0;
+    }
+    gst_object_unref (wrapped_context);
+    wrapped_context = NULL;
+    gst_object_unref (gst_display);
+    gst_display = NULL;
+  }
+
+  g_mutex_unlock (&context_lock);
+}
+
+static void
+notify_device_event (GstDevice * device, gboolean added)
+{
+  JNIEnv *env = get_jni_env ();
+  if (!env || !device_event_method) {
+    return;
+  }
+
+  gchar *display_name = gst_device_get_display_name (device);
+  jstring name = (*env)->NewStringUTF (env, display_name);
+  g_free (display_name);
+
+  (*env)->CallStaticVoidMethod (env, capture_class, device_event_method, name,
+      added ? JNI_TRUE : JNI_FALSE);
+  if ((*env)->ExceptionCheck (env)) {
+    (*env)->ExceptionDescribe (env);
+    (*env)->ExceptionClear (env);
+  }
+  (*env)->DeleteLocalRef (env, name);
+}
+
+static gboolean
+device_bus_cb (GstBus * bus, GstMessage * message, gpointer user_data)
+{
+  GstDevice *device;
+  gboolean added;
+  gboolean changed = FALSE;
+
+  switch (GST_MESSAGE_TYPE (message)) {
+    case GST_MESSAGE_DEVICE_ADDED:
+      gst_message_parse_device_added (message, &device);
+      added = TRUE;
+      break;
+    case GST_MESSAGE_DEVICE_REMOVED:
+      gst_message_parse_device_removed (message, &device);
+      added = FALSE;
+      break;
+    default:
+      return G_SOURCE_CONTINUE;
+  }
+
+  g_mutex_lock (&device_lock);
+  GList *found = g_list_find (device_list, device);
+  if (added && !found) {
+    device_list = g_list_append (device_list, gst_object_ref (device));
+    changed = TRUE;
+  } else if (!added && found) {
+    device_list = g_list_delete_link (device_list, found);
+    gst_object_unref (device);
+    changed = TRUE;
+  }
+  g_mutex_unlock (&device_lock);
+
+  // the device monitor announces devices we already know about when starting up
+  if (changed) {
+    notify_device_event (device, added);
+  }
+
+  gst_object_unref (device);
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+ensure_device_monitor ()
+{
+  g_mutex_lock (&device_lock);
+  if (!device_monitor) {
+    // this is kept running for the lifetime of the process, and keeps
+    // device_list up to date as devices get plugged in and removed
+    device_monitor = gst_device_monitor_new ();
+    gst_device_monitor_add_filter (device_monitor, "Video/Source", NULL);
+    if (!gst_device_monitor_start (device_monitor)) {
+      g_printerr ("GLVideo: Could not start device monitor, hotplugging is not supported\n");
+    }
+    device_list = gst_device_monitor_get_devices (device_monitor);
+
+    // this gets dispatched by our main loop
+    GstBus *bus = gst_device_monitor_get_bus (device_monitor);
+    gst_bus_add_watch (bus, device_bus_cb, NULL);
+    gst_object_unref (bus);
+  }
+  g_mutex_unlock (&device_lock);
+}
+
 static void *
 glvideo_mainloop (void * data) {
   mainloop = g_main_loop_new (NULL, FALSE);
@@ -441,36 +1574,168 @@ JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1init
     //fprintf (stderr, "GLVideo: display %p, surface %p, context %p at init\n",
     //  (void *) display, (void *) surface, (void *) context);
 
+    // for notifying GLCapture about devices getting plugged in or removed
+    (*env)->GetJavaVM (env, &jvm);
+    jclass capture = (*env)->FindClass (env, "gohai/glvideo/GLCapture");
+    if (capture) {
+      capture_class = (*env)->NewGlobalRef (env, capture);
+      device_event_method = (*env)->GetStaticMethodID (env, capture_class,
+          "deviceEvent", "(Ljava/lang/String;Z)V");
+      (*env)->DeleteLocalRef (env, capture);
+    }
+    if ((*env)->ExceptionCheck (env)) {
+      (*env)->ExceptionClear (env);
+      device_event_method = NULL;
+    }
+
+    // same for cue points
+    jclass video = (*env)->FindClass (env, "gohai/glvideo/GLVideo");
+    if (video) {
+      video_class = (*env)->NewGlobalRef (env, video);
+      cue_event_method = (*env)->GetStaticMethodID (env, video_class,
+          "cueEvent", "(JIJ)V");
+      (*env)->DeleteLocalRef (env, video);
+    }
+    if ((*env)->ExceptionCheck (env)) {
+      (*env)->ExceptionClear (env);
+      cue_event_method = NULL;
+    }
+
     // start GLib main loop in a separate thread
     thread = g_thread_new ("glvideo-mainloop", glvideo_mainloop, NULL);
 
     return JNI_TRUE;
   }
 
-JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1filenameToUri
-  (JNIEnv * env, jclass cls, jstring _fn) {
-    const char *fn = (*env)->GetStringUTFChars (env, _fn, JNI_FALSE);
-    gchar *uri = gst_filename_to_uri (fn, NULL);
-    (*env)->ReleaseStringUTFChars (env, _fn, fn);
-    jstring ret = (*env)->NewStringUTF (env, uri);
-    g_free (uri);
-    return ret;
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setSharedContexts
+  (JNIEnv * env, jclass cls, jint num) {
+    if (num < 0) {
+      num = 0;
+    } else if (GLVIDEO_MAX_SHARED_CONTEXTS < num) {
+      num = GLVIDEO_MAX_SHARED_CONTEXTS;
+    }
+    // this only affects pipelines created afterwards
+    g_mutex_lock (&context_lock);
+    num_shared_contexts = num;
+    g_mutex_unlock (&context_lock);
   }
 
-JNIEXPORT jobjectArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDevices
-  (JNIEnv * env, jclass cls) {
-    GList *devices = NULL;
-    GList *iter = NULL;
-    jclass stringClass = (*env)->FindClass (env, "java/lang/String");
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setBufferPool
+  (JNIEnv * env, jclass cls, jint min_buffers, jint max_buffers) {
+    if (max_buffers < 0) {
+      max_buffers = 0;
+    }
+    if (min_buffers < 0) {
+      min_buffers = 0;
+    } else if (0 < max_buffers && max_buffers < min_buffers) {
+      min_buffers = max_buffers;
+    }
+    // this only affects pipelines created afterwards
+    pool_min_buffers = min_buffers;
+    pool_max_buffers = max_buffers;
+  }
 
-    GstDeviceMonitor *monitor = gst_device_monitor_new ();
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setRingBufferSize
+  (JNIEnv * env, jclass cls, jlong size) {
+    // this only affects pipelines created afterwards
+    ring_buffer_size = (0 < size) ? size : 0;
+  }
 
-    gst_device_monitor_add_filter (monitor, "Video/Source", NULL);
-    devices = gst_device_monitor_get_devices (monitor);
+JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setDecoderRank
+  (JNIEnv * env, jclass cls, jstring _name, jint rank) {
+    const char *name = (*env)->GetStringUTFChars (env, _name, JNI_FALSE);
+    GstPluginFeature *feature = gst_registry_lookup_feature (gst_registry_get (), name);
+    (*env)->ReleaseStringUTFChars (env, _name, name);
 
-    // count number of results
-    int num_devices = 0;
-    for (iter = devices; iter != NULL; iter = iter->next) {
+    if (!feature) {
+      return JNI_FALSE;
+    }
+    // decodebin picks the decoder with the highest rank
+    gst_plugin_feature_set_rank (feature, rank);
+    gst_object_unref (feature);
+    return JNI_TRUE;
+  }
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setDecoderThreads
+  (JNIEnv * env, jclass cls, jint threads) {
+    // this only affects pipelines created afterwards
+    decoder_threads = (0 < threads) ? threads : 0;
+  }
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setDecoderQueue
+  (JNIEnv * env, jclass cls, jlong time) {
+    // this only affects pipelines created afterwards
+    decoder_queue_time = (0 < time) ? time : 0;
+  }
+
+JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getPluginDir
+  (JNIEnv * env, jclass cls) {
+    Dl_info info;
+
+    // plugins are typically installed in a subdirectory of where libgstreamer is
+    if (!dladdr ((void *) gst_init, &info) || !info.dli_fname) {
+      return NULL;
+    }
+    gchar *lib_dir = g_path_get_dirname (info.dli_fname);
+    gchar *plugin_dir = g_build_filename (lib_dir, "gstreamer-1.0", NULL);
+    jstring ret = (*env)->NewStringUTF (env, plugin_dir);
+    g_free (plugin_dir);
+    g_free (lib_dir);
+    return ret;
+  }
+
+JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1loadPlugins
+  (JNIEnv * env, jclass cls, jobjectArray _fns) {
+    jsize num = (*env)->GetArrayLength (env, _fns);
+    int loaded = 0;
+
+    for (jsize i=0; i < num; i++) {
+      jstring _fn = (jstring) (*env)->GetObjectArrayElement (env, _fns, i);
+      const char *fn = (*env)->GetStringUTFChars (env, _fn, JNI_FALSE);
+      GError *error = NULL;
+
+      // this also adds the plugin to the registry
+      GstPlugin *plugin = gst_plugin_load_file (fn, &error);
+      if (plugin) {
+        gst_object_unref (plugin);
+        loaded++;
+      } else {
+        g_printerr ("GLVideo: Could not load plugin %s: %s\n", fn,
+          error ? error->message : "unknown error");
+        g_clear_error (&error);
+      }
+
+      (*env)->ReleaseStringUTFChars (env, _fn, fn);
+      (*env)->DeleteLocalRef (env, _fn);
+    }
+
+    return loaded;
+  }
+
+JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1filenameToUri
+  (JNIEnv * env, jclass cls, jstring _fn) {
+    const char *fn = (*env)->GetStringUTFChars (env, _fn, JNI_FALSE);
+    gchar *uri = gst_filename_to_uri (fn, NULL);
+    (*env)->ReleaseStringUTFChars (env, _fn, fn);
+    jstring ret = (*env)->NewStringUTF (env, uri);
+    g_free (uri);
+    return ret;
+  }
+
+JNIEXPORT jobjectArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDevices
+  (JNIEnv * env, jclass cls) {
+    GList *devices = NULL;
+    GList *iter = NULL;
+    jclass stringClass = (*env)->FindClass (env, "java/lang/String");
+
+    // return a snapshot of the devices currently known to the monitor
+    ensure_device_monitor ();
+    g_mutex_lock (&device_lock);
+    devices = device_list;
+
+    // count number of results
+    int num_devices = 0;
+    for (iter = devices; iter != NULL; iter = iter->next) {
       num_devices++;
     }
 
@@ -505,7 +1770,9 @@ JNIEXPORT jobjectArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDevices
       g_free (class);
 
       GstCaps *caps = gst_device_get_caps (device);
-      (*env)->SetObjectArrayElement (env, row, 2, (*env)->NewStringUTF(env, gst_caps_to_string (caps)));
+      gchar *caps_str = gst_caps_to_string (caps);
+      (*env)->SetObjectArrayElement (env, row, 2, (*env)->NewStringUTF(env, caps_str));
+      g_free (caps_str);
       gst_caps_unref (caps);
 
       GstStructure *props = gst_device_get_properties (device);
@@ -532,67 +1799,150 @@ JNIEXPORT jobjectArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDevices
     }
 #endif
 
-    // XXX: unclear how teardown is supposed to work
-    gst_device_monitor_stop (monitor);
-    gst_object_unref (monitor);
+    g_mutex_unlock (&device_lock);
 
     return ret;
   }
 
+static gboolean
+device_framerate (GstCaps * device_caps, const gchar * media_type, int width,
+    int height, gint target_num, gint target_denom, gint * num, gint * denom)
+{
+  GstCaps *filter = gst_caps_new_empty_simple (media_type);
+  if (0 < width && 0 < height) {
+    gst_caps_set_simple (filter, "width", G_TYPE_INT, width,
+        "height", G_TYPE_INT, height, NULL);
+  }
+  GstCaps *caps = gst_caps_intersect (device_caps, filter);
+  gst_caps_unref (filter);
+
+  // the framerate closest to the target, over all raw formats or sizes
+  gboolean found = FALSE;
+  double target = (double) target_num / target_denom;
+  double best = 0.0;
+  for (guint i=0; i < gst_caps_get_size (caps); i++) {
+    GstStructure *str = gst_structure_copy (gst_caps_get_structure (caps, i));
+    gint n, d;
+    if (gst_structure_has_field (str, "framerate") &&
+        gst_structure_fixate_field_nearest_fraction (str, "framerate", target_num, target_denom) &&
+        gst_structure_get_fraction (str, "framerate", &n, &d) && 0 < d) {
+      double fps = (double) n / d;
+      if (!found || ABS (fps - target) < ABS (best - target)) {
+        *num = n;
+        *denom = d;
+        best = fps;
+        found = TRUE;
+      }
+    }
+    gst_structure_free (str);
+  }
+  gst_caps_unref (caps);
+  return found;
+}
+
+static void
+free_failed_pipeline (GLVIDEO_STATE_T * state)
+{
+  // gst_parse_launch might return a pipeline even on errors
+  if (state->pipeline) {
+    gst_object_unref (state->pipeline);
+  }
+  release_gl_contexts (state);
+  g_hash_table_destroy (state->textures);
+  g_array_free (state->cues, TRUE);
+  g_ptr_array_free (state->shaders, TRUE);
+  analysis_clear (&state->analysis);
+  g_cond_clear (&state->frame_cond);
+  g_mutex_clear (&state->buffer_lock);
+  free (state);
+
+  g_mutex_lock (&resource_lock);
+  pipelines_failed++;
+  g_mutex_unlock (&resource_lock);
+}
+
 GLVIDEO_STATE_T* createGlPipeline(const char * pipeline, GstElement * src, const char * caps, int flags) {
     GLVIDEO_STATE_T *state = malloc (sizeof (GLVIDEO_STATE_T));
     if (!state) {
       return 0L;
     }
     memset (state, 0, sizeof (*state));
+    state->open_time = g_get_monotonic_time ();
     state->flags = flags;
     state->rate = 1.0f;
+    state->pool_min_buffers = pool_min_buffers;
+    state->pool_max_buffers = pool_max_buffers;
+    state->textures = g_hash_table_new (NULL, NULL);
+    state->cues = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+    state->shaders = g_ptr_array_new ();
+    analysis_init (&state->analysis);
+    gst_segment_init (&state->segment, GST_FORMAT_UNDEFINED);
+    state->buffering_low = 10;
+    state->buffering_high = 100;
 
     // setup context sharing
-#ifdef __APPLE__
-    if (!gst_display) {
-      gst_display = gst_gl_display_new ();
-    } else {
-      g_object_ref (gst_display);
-    }
-    state->gl_context =
-      gst_gl_context_new_wrapped (GST_GL_DISPLAY (gst_display),
-      context, GST_GL_PLATFORM_CGL, gst_gl_context_get_current_gl_api (GST_GL_PLATFORM_CGL, NULL, NULL));
-#elif GLES2
-    if (!gst_display) {
-      gst_display = gst_gl_display_egl_new_with_egl_display (display);
-    } else {
-      g_object_ref (gst_display);
-    }
-    state->gl_context =
-      gst_gl_context_new_wrapped (GST_GL_DISPLAY (gst_display),
-      (guintptr) context, GST_GL_PLATFORM_EGL, GST_GL_API_GLES2);
-#else
-    if (!gst_display) {
-      gst_display = gst_gl_display_x11_new_with_display (display);
-    } else {
-      g_object_ref (gst_display);
-    }
-    state->gl_context =
-      gst_gl_context_new_wrapped (GST_GL_DISPLAY (gst_display),
-      (guintptr) context, GST_GL_PLATFORM_GLX, GST_GL_API_OPENGL);
-#endif
+    acquire_gl_contexts (state);
 
     // setup mutex to protect double buffering scheme
     g_mutex_init (&state->buffer_lock);
-
+    g_cond_init (&state->frame_cond);
+    state->current_pts = GST_CLOCK_TIME_NONE;
+    state->next_pts = GST_CLOCK_TIME_NONE;
+    state->duration = -1;
+    state->desc.pts = -1;
+    state->desc.position = -1;
+    state->desc.duration = -1;
+
+    gboolean ok = TRUE;
     if (pipeline) {
       // instantiate pipeline string
-      if (!init_pipeline_player (state, pipeline)) {
-        free (state);
-        return NULL;
-      }
+      ok = init_pipeline_player (state, pipeline);
     } else if (src) {
       // instantiate pipeline around source element
-      if (!init_device_player (state, src, caps)) {
-        free (state);
-        return NULL;
+      ok = init_device_player (state, src, caps);
+    }
+    if (!ok) {
+      free_failed_pipeline (state);
+      return NULL;
+    }
+
+    // handle DOWNLOAD flag
+    if ((state->flags & gohai_glvideo_GLVideo_DOWNLOAD) &&
+        g_object_class_find_property (G_OBJECT_GET_CLASS (state->pipeline), "ring-buffer-max-size")) {
+      guint play_flags;
+      g_object_get (state->pipeline, "flags", &play_flags, NULL);
+      g_object_set (state->pipeline, "flags", play_flags | GST_PLAY_FLAG_DOWNLOAD,
+          "ring-buffer-max-size", (guint64) ring_buffer_size, NULL);
+    }
+
+    // configure decoders as they get autoplugged
+    if (GST_IS_BIN (state->pipeline)) {
+      guint major, minor, micro, nano;
+      gst_version (&major, &minor, &micro, &nano);
+      // deep-element-added is new in GStreamer 1.10
+      bool deep = (1 < major || (major == 1 && 10 <= minor));
+      if (deep) {
+        g_signal_connect (state->pipeline, "deep-element-added",
+            G_CALLBACK (deep_element_added_cb), state);
+      } else {
+        g_signal_connect (state->pipeline, "element-added",
+            G_CALLBACK (element_added_cb), state);
+      }
+
+      // elements of parsed pipelines, such as decodebin, are already there
+      GstIterator *it = gst_bin_iterate_elements (GST_BIN (state->pipeline));
+      GValue item = G_VALUE_INIT;
+      while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+        GstElement *element = g_value_get_object (&item);
+        if (deep) {
+          configure_element (element, state);
+        } else {
+          element_added_cb (GST_BIN (state->pipeline), element, state);
+        }
+        g_value_reset (&item);
       }
+      g_value_unset (&item);
+      gst_iterator_free (it);
     }
 
     // connect the bus handlers
@@ -608,11 +1958,19 @@ GLVIDEO_STATE_T* createGlPipeline(const char * pipeline, GstElement * src, const
     g_signal_connect (G_OBJECT (bus), "message::buffering",
       (GCallback) buffering_cb, state);
     g_signal_connect (G_OBJECT (bus), "message::eos", (GCallback) eos_cb, state);
+    g_signal_connect (G_OBJECT (bus), "message::qos", (GCallback) qos_cb, state);
     gst_object_unref (bus);
 
     // start paused
     gst_element_set_state (state->pipeline, GST_STATE_PAUSED);
 
+    gint64 open_time = g_get_monotonic_time () - state->open_time;
+    g_mutex_lock (&resource_lock);
+    pipelines_opened++;
+    open_time_total += open_time;
+    open_time_max = MAX (open_time_max, open_time);
+    g_mutex_unlock (&resource_lock);
+
     return state;
 }
 
@@ -629,14 +1987,12 @@ JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1openPipeline
 
 GstElement* getDeviceSrcElement(const char * deviceName) {
   GList *iter;
-  // XXX: or reuse the same monitor?
-  GstDeviceMonitor *monitor = gst_device_monitor_new ();
   GstElement *src = NULL;
 
-  gst_device_monitor_add_filter (monitor, "Video/Source", NULL);
-  iter = gst_device_monitor_get_devices (monitor);
+  ensure_device_monitor ();
+  g_mutex_lock (&device_lock);
 
-  for (; iter != NULL; iter = iter->next) {
+  for (iter = device_list; iter != NULL; iter = iter->next) {
     GstDevice *device = iter->data;
     gchar *display_name = gst_device_get_display_name (device);
     if (!strcmp (display_name, deviceName)) {
@@ -648,12 +2004,155 @@ GstElement* getDeviceSrcElement(const char * deviceName) {
     g_free (display_name);
   }
 
-  gst_device_monitor_stop (monitor);
-  gst_object_unref (monitor);
+  g_mutex_unlock (&device_lock);
 
   return src;
 }
 
+JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1negotiateDeviceCaps
+  (JNIEnv * env, jclass cls, jstring _deviceName, jint width, jint height, jfloat fps) {
+    GList *iter;
+    GstCaps *device_caps = NULL;
+
+    const char *deviceName = (*env)->GetStringUTFChars (env, _deviceName, JNI_FALSE);
+    ensure_device_monitor ();
+    g_mutex_lock (&device_lock);
+    for (iter = device_list; iter != NULL; iter = iter->next) {
+      GstDevice *device = iter->data;
+      gchar *display_name = gst_device_get_display_name (device);
+      if (!strcmp (display_name, deviceName)) {
+        device_caps = gst_device_get_caps (device);
+      }
+      g_free (display_name);
+      if (device_caps) {
+        break;
+      }
+    }
+    g_mutex_unlock (&device_lock);
+    (*env)->ReleaseStringUTFChars (env, _deviceName, deviceName);
+
+    if (!device_caps) {
+      return NULL;
+    }
+
+    // the highest framerate each format can do at this size
+    gint raw_num = 0, raw_denom = 1, jpeg_num = 0, jpeg_denom = 1;
+    gboolean raw = device_framerate (device_caps, "video/x-raw", width, height,
+        G_MAXINT, 1, &raw_num, &raw_denom);
+    gboolean jpeg = device_framerate (device_caps, "image/jpeg", width, height,
+        G_MAXINT, 1, &jpeg_num, &jpeg_denom);
+
+    gint fps_num = 0, fps_denom = 1;
+    if (0.0f < fps) {
+      gst_util_double_to_fraction (fps, &fps_num, &fps_denom);
+    }
+
+    // uncompressed frames cost the least CPU, but take a lot more USB bandwidth,
+    // so cameras only offer them at lower framerates for larger sizes
+    gboolean use_raw;
+    if (!raw && !jpeg) {
+      gst_caps_unref (device_caps);
+      return NULL;
+    } else if (!jpeg) {
+      use_raw = TRUE;
+    } else if (!raw) {
+      use_raw = FALSE;
+    } else if (0.0f < fps && 0 <= gst_util_fraction_compare (raw_num, raw_denom, fps_num, fps_denom)) {
+      // fast enough without having to decode
+      use_raw = TRUE;
+    } else {
+      // whichever is faster, raw on a tie
+      use_raw = (0 <= gst_util_fraction_compare (raw_num, raw_denom, jpeg_num, jpeg_denom));
+    }
+
+    const gchar *media_type = (use_raw) ? "video/x-raw" : "image/jpeg";
+    gint num = (use_raw) ? raw_num : jpeg_num;
+    gint denom = (use_raw) ? raw_denom : jpeg_denom;
+    if (0.0f < fps) {
+      // the supported framerate closest to the one requested
+      device_framerate (device_caps, media_type, width, height, fps_num, fps_denom, &num, &denom);
+    }
+    gst_caps_unref (device_caps);
+
+    GstCaps *caps = gst_caps_new_empty_simple (media_type);
+    if (0 < width && 0 < height) {
+      gst_caps_set_simple (caps, "width", G_TYPE_INT, width,
+          "height", G_TYPE_INT, height, NULL);
+    }
+    gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION, num, denom, NULL);
+    gchar *str = gst_caps_to_string (caps);
+    gst_caps_unref (caps);
+
+    jstring ret = (*env)->NewStringUTF (env, str);
+    g_free (str);
+    return ret;
+  }
+
+static gint64
+proc_rss (void)
+{
+  gchar *contents = NULL;
+  gint64 rss = -1;
+
+  // the second field is the resident set size, in pages
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL)) {
+    long pages;
+    if (sscanf (contents, "%*d %ld", &pages) == 1) {
+      rss = (gint64) pages * sysconf (_SC_PAGESIZE);
+    }
+    g_free (contents);
+  }
+  return rss;
+}
+
+static gint64
+proc_count_entries (const gchar * path)
+{
+  GDir *dir = g_dir_open (path, 0, NULL);
+  gint64 count = 0;
+
+  if (!dir) {
+    // not on Linux
+    return -1;
+  }
+  while (g_dir_read_name (dir)) {
+    count++;
+  }
+  g_dir_close (dir);
+  return count;
+}
+
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getResourceStats
+  (JNIEnv * env, jclass cls) {
+    jlong stats[13];
+
+    g_mutex_lock (&resource_lock);
+    stats[0] = pipelines_opened;
+    stats[1] = pipelines_closed;
+    stats[2] = pipelines_failed;
+    stats[3] = pipelines_opened - pipelines_closed;
+    // in us
+    stats[4] = (pipelines_opened) ? open_time_total / pipelines_opened : 0;
+    stats[5] = open_time_max;
+    stats[6] = (first_frames) ? first_frame_total / first_frames : 0;
+    stats[7] = first_frame_max;
+    g_mutex_unlock (&resource_lock);
+
+    stats[8] = g_atomic_int_get (&live_textures);
+    stats[9] = g_atomic_int_get (&live_gl_objects);
+    stats[10] = proc_rss ();
+    // minus the one for reading the directory
+    stats[11] = proc_count_entries ("/proc/self/fd");
+    if (0 < stats[11]) {
+      stats[11]--;
+    }
+    stats[12] = proc_count_entries ("/proc/self/task");
+
+    jlongArray ret = (*env)->NewLongArray (env, 13);
+    (*env)->SetLongArrayRegion (env, ret, 0, 13, stats);
+    return ret;
+  }
+
 JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1openDevice
   (JNIEnv * env, jclass cls, jstring _deviceName, jstring _caps, jint flags) {
     GLVIDEO_STATE_T *state;
@@ -692,16 +2191,37 @@ JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1isAvailable
   }
 
 JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getFrame
-  (JNIEnv * env, jclass cls, jlong handle) {
+  (JNIEnv * env, jclass cls, jlong handle, jint sketch_frame) {
     GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    gint64 duration = -1;
+
+    // the duration is usually only known once the first frames arrived, and
+    // never for live sources, so try a couple of times, but not on the streaming thread
+    // (duration is only written from here, so reading it unlocked is fine)
+    if (state->duration == -1 && state->duration_queries < 10) {
+      gst_element_query_duration (state->pipeline, GST_FORMAT_TIME, &duration);
+    }
+
     g_mutex_lock (&state->buffer_lock);
+    state->sketch_frame = sketch_frame;
+    if (0 <= duration) {
+      state->duration = duration;
+    } else if (state->duration == -1 && state->next_buffer) {
+      state->duration_queries++;
+    }
     if (likely (state->current_buffer != NULL)) {
       gst_buffer_unref (state->current_buffer);
     }
+    if (likely (state->next_buffer != NULL)) {
+      state->frames_consumed++;
+      state->consume_latency += g_get_monotonic_time () - state->next_since;
+      state->current_pts = state->next_pts;
+    }
     state->current_buffer = state->next_buffer;
     state->current_tex = state->next_tex;
     state->next_buffer = NULL;
     state->next_tex = 0;
+    publish_frame_desc (state);
     g_mutex_unlock (&state->buffer_lock);
     return state->current_tex;
   }
@@ -710,7 +2230,18 @@ JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1startPlayback
   (JNIEnv * env, jclass cls, jlong handle) {
     GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
 
-    gst_element_set_state (state->pipeline, GST_STATE_PLAYING);
+    bool buffering;
+
+    g_mutex_lock (&state->buffer_lock);
+    state->playing_requested = true;
+    buffering = state->buffering;
+    publish_frame_desc (state);
+    g_mutex_unlock (&state->buffer_lock);
+
+    // otherwise this happens once enough data is buffered
+    if (!buffering) {
+      gst_element_set_state (state->pipeline, GST_STATE_PLAYING);
+    }
   }
 
 JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1isPlaying
@@ -726,6 +2257,13 @@ JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1stopPlayback
   (JNIEnv * env, jclass cls, jlong handle) {
     GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
 
+    g_mutex_lock (&state->buffer_lock);
+    state->playing_requested = false;
+    // the running time stops while paused, so these would fire too early
+    unschedule_cues (state);
+    publish_frame_desc (state);
+    g_mutex_unlock (&state->buffer_lock);
+
     gst_element_set_state (state->pipeline, GST_STATE_PAUSED);
   }
 
@@ -743,12 +2281,96 @@ JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1seek
     wait_for_state_change (state);
 
     event = gst_event_new_seek (state->rate,
-      GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
+      GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | get_trick_flags (state),
       GST_SEEK_TYPE_SET, (gint64)(sec * 1000000000), GST_SEEK_TYPE_SET,
       GST_CLOCK_TIME_NONE);
     return gst_element_send_event (state->vsink, event);
   }
 
+JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1step
+  (JNIEnv * env, jclass cls, jlong handle, jint frames) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    GstClockTime current;
+    GstClockTime pts = GST_CLOCK_TIME_NONE;
+    guint64 serial;
+    gboolean ret;
+
+    // stepping works on the paused pipeline
+    g_mutex_lock (&state->buffer_lock);
+    state->playing_requested = false;
+    publish_frame_desc (state);
+    g_mutex_unlock (&state->buffer_lock);
+    gst_element_set_state (state->pipeline, GST_STATE_PAUSED);
+    wait_for_state_change (state);
+
+    g_mutex_lock (&state->buffer_lock);
+    serial = state->frame_serial;
+    current = state->current_pts;
+    g_mutex_unlock (&state->buffer_lock);
+
+    if (0 < frames) {
+      // the sink skips all but the last buffer, and prerolls on that one
+      ret = gst_element_send_event (state->vsink,
+        gst_event_new_step (GST_FORMAT_BUFFERS, frames, 1.0, TRUE, FALSE));
+    } else if (frames < 0) {
+      GstCaps *caps;
+      const GstStructure *str;
+      int num = 0;
+      int denom = 0;
+
+      // events_cb replaces the caps on the streaming thread
+      g_mutex_lock (&state->buffer_lock);
+      caps = (state->caps) ? gst_caps_ref (state->caps) : NULL;
+      g_mutex_unlock (&state->buffer_lock);
+
+      if (!caps || !GST_CLOCK_TIME_IS_VALID (current)) {
+        if (caps) {
+          gst_caps_unref (caps);
+        }
+        return -1;
+      }
+      str = gst_caps_get_structure (caps, 0);
+      gst_structure_get_fraction (str, "framerate", &num, &denom);
+      gst_caps_unref (caps);
+      if (num <= 0 || denom <= 0) {
+        return -1;
+      }
+      GstClockTime duration = gst_util_uint64_scale (GST_SECOND, denom, num);
+      gint64 target = MAX ((gint64) current + frames * (gint64) duration, 0);
+
+      // decode from the keyframe before up to the frame we want, aiming
+      // at its middle to be safe from rounding errors
+      if (state->rate < 0) {
+        state->rate = 1.0f;
+      }
+      ret = gst_element_send_event (state->vsink, gst_event_new_seek (state->rate,
+        GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE,
+        GST_SEEK_TYPE_SET, target + duration / 2, GST_SEEK_TYPE_SET,
+        GST_CLOCK_TIME_NONE));
+    } else {
+      return current;
+    }
+
+    if (!ret) {
+      return -1;
+    }
+
+    // wait for the new frame to be prerolled
+    gint64 end = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+    g_mutex_lock (&state->buffer_lock);
+    while (state->frame_serial == serial) {
+      if (!g_cond_wait_until (&state->frame_cond, &state->buffer_lock, end)) {
+        break;
+      }
+    }
+    if (state->frame_serial != serial) {
+      pts = state->next_pts;
+    }
+    g_mutex_unlock (&state->buffer_lock);
+
+    return GST_CLOCK_TIME_IS_VALID (pts) ? (jlong) pts : -1;
+  }
+
 JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setSpeed
   (JNIEnv * env, jclass cls, jlong handle, jfloat rate) {
     GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
@@ -772,7 +2394,7 @@ JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setSpeed
 
     state->rate = rate;
     event = gst_event_new_seek (state->rate,
-      GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+      GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | get_trick_flags (state),
       GST_SEEK_TYPE_SET, start, GST_SEEK_TYPE_SET,
       stop);
 
@@ -861,13 +2483,436 @@ JNIEXPORT jfloat JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getFramerate
     return (float)num/denom;
   }
 
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setBufferingWatermarks
+  (JNIEnv * env, jclass cls, jlong handle, jint low, jint high) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+
+    g_mutex_lock (&state->buffer_lock);
+    state->buffering_low = CLAMP (low, 0, 100);
+    state->buffering_high = CLAMP (high, state->buffering_low, 100);
+    g_mutex_unlock (&state->buffer_lock);
+  }
+
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getBufferingStats
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    jlong stats[6];
+
+    g_mutex_lock (&state->buffer_lock);
+    stats[0] = state->buffering_percent;
+    stats[1] = state->buffering_events;
+    // in ms, including the current period of buffering
+    stats[2] = state->buffering_time;
+    if (state->buffering) {
+      stats[2] += g_get_monotonic_time () - state->buffering_since;
+    }
+    stats[2] /= 1000;
+    stats[3] = state->buffering_avg_in;
+    stats[4] = state->buffering_avg_out;
+    stats[5] = state->buffering_left;
+    g_mutex_unlock (&state->buffer_lock);
+
+    jlongArray ret = (*env)->NewLongArray (env, 6);
+    (*env)->SetLongArrayRegion (env, ret, 0, 6, stats);
+    return ret;
+  }
+
+JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getTextureMemory
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    const GstStructure *str;
+    int width = 0;
+    int height = 0;
+    guint num_textures;
+
+    wait_for_state_change (state);
+
+    if (!state->caps || !gst_caps_is_fixed (state->caps)) {
+      return 0;
+    }
+    str = gst_caps_get_structure (state->caps, 0);
+    gst_structure_get_int (str, "width", &width);
+    gst_structure_get_int (str, "height", &height);
+
+    g_mutex_lock (&state->buffer_lock);
+    num_textures = g_hash_table_size (state->textures);
+    g_mutex_unlock (&state->buffer_lock);
+
+    // RGBA
+    return (jlong) num_textures * width * height * 4;
+  }
+
+JNIEXPORT jintArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getRegions
+  (JNIEnv * env, jclass cls, jlong handle, jintArray _rects) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    GLuint tex;
+    GLint prev_fbo;
+    GLuint fbo;
+    jsize len = (*env)->GetArrayLength (env, _rects);
+    jsize num_rects = len / 4;
+    jsize num_pixels = 0;
+
+    if (len % 4 != 0) {
+      jclass exception = (*env)->FindClass (env, "java/lang/IllegalArgumentException");
+      (*env)->ThrowNew (env, exception, "Invalid array length for getRegions");
+      return NULL;
+    }
+
+    // this is the texture last returned by getFrame, which we still hold a reference to
+    g_mutex_lock (&state->buffer_lock);
+    tex = state->current_tex;
+    g_mutex_unlock (&state->buffer_lock);
+    if (tex == 0) {
+      return NULL;
+    }
+
+    jint *rects = (*env)->GetIntArrayElements (env, _rects, NULL);
+    for (jsize i=0; i < num_rects; i++) {
+      // the regions are clipped to the frame in Java, but pixels would be
+      // too small with a negative size
+      if (rects[i*4+2] < 0 || rects[i*4+3] < 0) {
+        (*env)->ReleaseIntArrayElements (env, _rects, rects, JNI_ABORT);
+        jclass exception = (*env)->FindClass (env, "java/lang/IllegalArgumentException");
+        (*env)->ThrowNew (env, exception, "Invalid region size for getRegions");
+        return NULL;
+      }
+      num_pixels += rects[i*4+2] * rects[i*4+3];
+    }
+    guint32 *pixels = g_new (guint32, num_pixels);
+
+    // this runs on Processing's GL context, which shares the texture
+    glGetIntegerv (GL_FRAMEBUFFER_BINDING, &prev_fbo);
+    glGenFramebuffers (1, &fbo);
+    glBindFramebuffer (GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+
+    // only read back the requested regions, all in one go
+    guint32 *dst = pixels;
+    for (jsize i=0; i < num_rects; i++) {
+      GLint w = rects[i*4+2];
+      GLint h = rects[i*4+3];
+      glReadPixels (rects[i*4], rects[i*4+1], w, h, GL_RGBA, GL_UNSIGNED_BYTE, dst);
+      dst += w * h;
+    }
+
+    glBindFramebuffer (GL_FRAMEBUFFER, prev_fbo);
+    glDeleteFramebuffers (1, &fbo);
+    (*env)->ReleaseIntArrayElements (env, _rects, rects, JNI_ABORT);
+
+    // RGBA bytes to ARGB ints
+    for (jsize i=0; i < num_pixels; i++) {
+      guint8 *p = (guint8 *) &pixels[i];
+      pixels[i] = ((guint32) p[3] << 24) | (p[0] << 16) | (p[1] << 8) | p[2];
+    }
+
+    jintArray ret = (*env)->NewIntArray (env, num_pixels);
+    (*env)->SetIntArrayRegion (env, ret, 0, num_pixels, (jint *) pixels);
+    g_free (pixels);
+    return ret;
+  }
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setAdaptive
+  (JNIEnv * env, jclass cls, jlong handle, jboolean enabled) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+
+    // the controller's state is only touched on the main loop thread
+    if (enabled) {
+      invoke_on_main_loop (adaptive_start_cb, state);
+    } else {
+      invoke_on_main_loop (adaptive_disable_cb, state);
+    }
+  }
+
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getAdaptiveStats
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    jlong stats[7];
+
+    g_mutex_lock (&state->buffer_lock);
+    stats[0] = state->quality;
+    stats[1] = state->quality_down;
+    stats[2] = state->quality_up;
+    stats[3] = state->total_missed;
+    stats[4] = state->total_qos_events;
+    // in us, over the last interval
+    stats[5] = state->avg_consume_latency;
+    stats[6] = state->last_lateness / 1000;
+    g_mutex_unlock (&state->buffer_lock);
+
+    jlongArray ret = (*env)->NewLongArray (env, 7);
+    (*env)->SetLongArrayRegion (env, ret, 0, 7, stats);
+    return ret;
+  }
+
+static gint
+compare_clock_times (gconstpointer a, gconstpointer b)
+{
+  GstClockTime ta = *(const GstClockTime *) a;
+  GstClockTime tb = *(const GstClockTime *) b;
+  return (ta < tb) ? -1 : (ta > tb);
+}
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setCues
+  (JNIEnv * env, jclass cls, jlong handle, jfloatArray _times) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    jsize num = (*env)->GetArrayLength (env, _times);
+    jfloat *times = (*env)->GetFloatArrayElements (env, _times, NULL);
+
+    g_mutex_lock (&state->buffer_lock);
+    unschedule_cues (state);
+    g_array_set_size (state->cues, 0);
+    for (jsize i=0; i < num; i++) {
+      GstClockTime t = (GstClockTime)(times[i] * GST_SECOND);
+      g_array_append_val (state->cues, t);
+    }
+    // indices passed to cueEvent refer to the sorted list, GLVideo.cues
+    // maps them back to the order they were passed in
+    g_array_sort (state->cues, compare_clock_times);
+    // only cues after the current frame fire
+    GstClockTime stream_time = 0;
+    if (state->segment.format == GST_FORMAT_TIME && GST_CLOCK_TIME_IS_VALID (state->next_pts)) {
+      stream_time = gst_segment_to_stream_time (&state->segment, GST_FORMAT_TIME, state->next_pts);
+    }
+    reset_cues (state, GST_CLOCK_TIME_IS_VALID (stream_time) ? stream_time : 0);
+    g_mutex_unlock (&state->buffer_lock);
+
+    (*env)->ReleaseFloatArrayElements (env, _times, times, JNI_ABORT);
+  }
+
+static GstPadProbeReturn
+insert_shader_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstElement *shader = GST_ELEMENT (user_data);
+  if (g_object_get_data (G_OBJECT (shader), "glvideo-removed")) {
+    // removed before it made it into the pipeline
+    return GST_PAD_PROBE_REMOVE;
+  }
+
+  // pad is the filter's sink pad, link whatever is in front of it to the shader,
+  // so that shaders added in a row end up in the same order
+  GstPad *peer = gst_pad_get_peer (pad);
+  GstElement *filter = gst_pad_get_parent_element (pad);
+
+  gst_pad_unlink (peer, pad);
+  gst_bin_add (GST_BIN (GST_ELEMENT_PARENT (filter)), shader);
+  GstPad *shader_sink = gst_element_get_static_pad (shader, "sink");
+  gst_pad_link (peer, shader_sink);
+  gst_object_unref (shader_sink);
+  gst_element_link (shader, filter);
+  gst_element_sync_state_with_parent (shader);
+
+  gst_object_unref (filter);
+  gst_object_unref (peer);
+  return GST_PAD_PROBE_REMOVE;
+}
+
+static gboolean
+dispose_shader_cb (gpointer user_data)
+{
+  GstElement *shader = GST_ELEMENT (user_data);
+  // not from the streaming thread
+  gst_element_set_state (shader, GST_STATE_NULL);
+  if (GST_ELEMENT_PARENT (shader)) {
+    gst_bin_remove (GST_BIN (GST_ELEMENT_PARENT (shader)), shader);
+  }
+  gst_object_unref (shader);
+  return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn
+remove_shader_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstElement *shader = GST_ELEMENT (user_data);
+  // pad is the shader's sink pad
+  GstPad *src = gst_element_get_static_pad (shader, "src");
+  GstPad *prev = gst_pad_get_peer (pad);
+  GstPad *next = gst_pad_get_peer (src);
+
+  if (prev && next) {
+    gst_pad_unlink (prev, pad);
+    gst_pad_unlink (src, next);
+    gst_pad_link (prev, next);
+  }
+
+  if (next) {
+    gst_object_unref (next);
+  }
+  if (prev) {
+    gst_object_unref (prev);
+  }
+  gst_object_unref (src);
+  // this runs on the main loop thread
+  g_idle_add (dispose_shader_cb, gst_object_ref (shader));
+  return GST_PAD_PROBE_REMOVE;
+}
+
+JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1addShader
+  (JNIEnv * env, jclass cls, jlong handle, jstring _fragment) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+
+    GstElement *shader = gst_element_factory_make ("glshader", NULL);
+    if (!shader) {
+      g_printerr ("GLVideo: Could not create glshader element\n");
+      return -1;
+    }
+    const char *fragment = (*env)->GetStringUTFChars (env, _fragment, JNI_FALSE);
+    g_object_set (shader, "fragment", fragment, NULL);
+    (*env)->ReleaseStringUTFChars (env, _fragment, fragment);
+
+    // keep our own reference, to be able to set uniforms
+    g_ptr_array_add (state->shaders, gst_object_ref_sink (shader));
+
+    // insert in front of the capsfilter as soon as no data flows through it,
+    // which might be right away
+    GstPad *pad = gst_element_get_static_pad (state->filter, "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_IDLE, insert_shader_cb,
+        gst_object_ref (shader), gst_object_unref);
+    gst_object_unref (pad);
+
+    return state->shaders->len - 1;
+  }
+
+JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setShaderUniforms
+  (JNIEnv * env, jclass cls, jlong handle, jint index, jstring _uniforms) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+
+    if (index < 0 || state->shaders->len <= (guint) index || !g_ptr_array_index (state->shaders, index)) {
+      return FALSE;
+    }
+
+    const char *uniforms = (*env)->GetStringUTFChars (env, _uniforms, JNI_FALSE);
+    GstStructure *str = gst_structure_from_string (uniforms, NULL);
+    (*env)->ReleaseStringUTFChars (env, _uniforms, uniforms);
+    if (!str) {
+      return FALSE;
+    }
+
+    // picked up by glshader before rendering the next frame
+    g_object_set (g_ptr_array_index (state->shaders, index), "uniforms", str, NULL);
+    gst_structure_free (str);
+    return TRUE;
+  }
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1removeShader
+  (JNIEnv * env, jclass cls, jlong handle, jint index) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+
+    if (index < 0 || state->shaders->len <= (guint) index || !g_ptr_array_index (state->shaders, index)) {
+      return;
+    }
+    GstElement *shader = g_ptr_array_index (state->shaders, index);
+    // keep the indices of the other shaders stable
+    g_ptr_array_index (state->shaders, index) = NULL;
+    g_object_set_data (G_OBJECT (shader), "glvideo-removed", GINT_TO_POINTER (1));
+
+    // unlink as soon as no data flows through the shader
+    GstPad *pad = gst_element_get_static_pad (shader, "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_IDLE, remove_shader_cb, shader,
+        gst_object_unref);
+    gst_object_unref (pad);
+  }
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1setAnalysis
+  (JNIEnv * env, jclass cls, jlong handle, jint grid_width, jint grid_height, jint threshold) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    // a grid of 0x0 disables the analysis
+    analysis_configure (&state->analysis, grid_width, grid_height, threshold);
+  }
+
+JNIEXPORT jintArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getHistogram
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    jint hist[GLVIDEO_ANALYSIS_BINS];
+
+    g_mutex_lock (&state->analysis.lock);
+    for (int i=0; i < GLVIDEO_ANALYSIS_BINS; i++) {
+      hist[i] = state->analysis.histogram[i];
+    }
+    g_mutex_unlock (&state->analysis.lock);
+
+    jintArray ret = (*env)->NewIntArray (env, GLVIDEO_ANALYSIS_BINS);
+    (*env)->SetIntArrayRegion (env, ret, 0, GLVIDEO_ANALYSIS_BINS, hist);
+    return ret;
+  }
+
+JNIEXPORT jintArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDifference
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+
+    g_mutex_lock (&state->analysis.lock);
+    int len = state->analysis.diff_len;
+    jint *diff = g_new (jint, MAX (len, 1));
+    for (int i=0; i < len; i++) {
+      diff[i] = state->analysis.diff[i];
+    }
+    g_mutex_unlock (&state->analysis.lock);
+
+    jintArray ret = (*env)->NewIntArray (env, len);
+    (*env)->SetIntArrayRegion (env, ret, 0, len, diff);
+    g_free (diff);
+    return ret;
+  }
+
+JNIEXPORT jintArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getMotion
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    jint motion[6];
+
+    g_mutex_lock (&state->analysis.lock);
+    for (int i=0; i < 4; i++) {
+      motion[i] = state->analysis.bbox[i];
+    }
+    motion[4] = state->analysis.changed;
+    motion[5] = state->analysis.frames;
+    g_mutex_unlock (&state->analysis.lock);
+
+    jintArray ret = (*env)->NewIntArray (env, 6);
+    (*env)->SetIntArrayRegion (env, ret, 0, 6, motion);
+    return ret;
+  }
+
+JNIEXPORT jobject JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getFrameDescriptor
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    // valid until the pipeline is closed
+    return (*env)->NewDirectByteBuffer (env, &state->desc, sizeof (state->desc));
+  }
+
+JNIEXPORT jstring JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getDecoder
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
+    jstring ret = NULL;
+
+    wait_for_state_change (state);
+
+    g_mutex_lock (&state->buffer_lock);
+    if (state->decoder) {
+      ret = (*env)->NewStringUTF (env, state->decoder);
+    }
+    g_mutex_unlock (&state->buffer_lock);
+    return ret;
+  }
+
 JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1close
   (JNIEnv * env, jclass cls, jlong handle) {
     GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) handle;
 
+    // this waits for a running adaptive_cb to return
+    invoke_on_main_loop (adaptive_stop_cb, state);
+
     // stop pipeline
     gst_element_set_state (state->pipeline, GST_STATE_NULL);
 
+    // no more frames are being copied at this point
+    atlas_detach (state);
+
+    // the signal watch holds on to the bus, and with it a file descriptor
+    GstBus *bus = gst_element_get_bus (state->pipeline);
+    gst_bus_remove_signal_watch (bus);
+    gst_bus_disable_sync_message_emission (bus);
+    gst_bus_set_sync_handler (bus, NULL, NULL, NULL);
+    gst_object_unref (bus);
+
     // free both buffers
     g_mutex_lock (&state->buffer_lock);
     if (state->current_buffer) {
@@ -878,19 +2923,627 @@ JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1close
       gst_buffer_unref (state->next_buffer);
       state->next_buffer = NULL;
     }
+    unschedule_cues (state);
     g_mutex_unlock (&state->buffer_lock);
 
     gst_object_unref (state->vsink);
+    gst_object_unref (state->filter);
+    if (state->videorate) {
+      gst_object_unref (state->videorate);
+    }
     gst_object_unref (state->pipeline);
 
     if (state->caps) {
       gst_caps_unref (state->caps);
     }
 
-    gst_object_unref (state->gl_context);
-    gst_object_unref (gst_display);
+    release_gl_contexts (state);
 
+    g_atomic_int_add (&live_textures, -(gint) g_hash_table_size (state->textures));
+    g_hash_table_destroy (state->textures);
+    g_free (state->decoder);
+    g_array_free (state->cues, TRUE);
+    for (guint i=0; i < state->shaders->len; i++) {
+      if (g_ptr_array_index (state->shaders, i)) {
+        gst_object_unref (g_ptr_array_index (state->shaders, i));
+      }
+    }
+    g_ptr_array_free (state->shaders, TRUE);
+    analysis_clear (&state->analysis);
+    g_cond_clear (&state->frame_cond);
     g_mutex_clear (&state->buffer_lock);
 
     free (state);
+
+    g_mutex_lock (&resource_lock);
+    pipelines_closed++;
+    g_mutex_unlock (&resource_lock);
+  }
+
+static gboolean
+recorder_queue_full (GLVIDEO_RECORDER_T * rec)
+{
+  guint64 level = 0;
+
+  if (rec->block) {
+    // push-buffer is going to block instead
+    return FALSE;
+  }
+  g_object_get (rec->appsrc, "current-level-bytes", &level, NULL);
+  return (rec->max_bytes < level + rec->frame_size);
+}
+
+static void
+recorder_push_buffer (GLVIDEO_RECORDER_T * rec, GstBuffer * buffer, GstClockTime pts)
+{
+  GstFlowReturn ret;
+
+  GST_BUFFER_PTS (buffer) = pts;
+  g_signal_emit_by_name (rec->appsrc, "push-buffer", buffer, &ret);
+  // the signal doesn't take ownership of the buffer
+  gst_buffer_unref (buffer);
+
+  if (ret == GST_FLOW_OK) {
+    rec->frames_recorded++;
+  } else {
+    rec->frames_dropped++;
+  }
+}
+
+#ifndef GLES2
+static void
+recorder_push_pbo (GLVIDEO_RECORDER_T * rec, int idx)
+{
+  if (recorder_queue_full (rec)) {
+    rec->frames_dropped++;
+    return;
+  }
+
+  glBindBuffer (GL_PIXEL_PACK_BUFFER, rec->pbos[idx]);
+  void *pixels = glMapBuffer (GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+  if (pixels) {
+    GstBuffer *buffer = gst_buffer_new_allocate (NULL, rec->frame_size, NULL);
+    gst_buffer_fill (buffer, 0, pixels, rec->frame_size);
+    glUnmapBuffer (GL_PIXEL_PACK_BUFFER);
+    recorder_push_buffer (rec, buffer, rec->pts[idx]);
+  } else {
+    rec->frames_dropped++;
+  }
+  glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+}
+#endif
+
+JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1openRecorder
+  (JNIEnv * env, jclass cls, jstring _fn, jstring _encoder, jint width, jint height, jint fps, jint max_frames, jboolean block) {
+    GLVIDEO_RECORDER_T *rec = malloc (sizeof (GLVIDEO_RECORDER_T));
+    if (!rec) {
+      return 0L;
+    }
+    memset (rec, 0, sizeof (*rec));
+    rec->width = width;
+    rec->height = height;
+    rec->frame_size = (gsize) width * height * 4;
+    rec->max_bytes = (guint64) max_frames * rec->frame_size;
+    rec->block = block;
+
+    // glReadPixels returns the image bottom-up
+    const char *encoder = (*env)->GetStringUTFChars (env, _encoder, JNI_FALSE);
+    gchar *pipeline = g_strdup_printf ("appsrc name=src ! videoflip method=vertical-flip ! "
+        "videoconvert ! %s ! filesink name=sink", encoder);
+    (*env)->ReleaseStringUTFChars (env, _encoder, encoder);
+
+    GError *error = NULL;
+    rec->pipeline = gst_parse_launch (pipeline, &error);
+    if (error) {
+      g_printerr ("Could not parse pipeline %s: %s\n", pipeline, error->message);
+      g_free (pipeline);
+      g_error_free (error);
+      if (rec->pipeline) {
+        gst_object_unref (rec->pipeline);
+      }
+      free (rec);
+      return 0L;
+    }
+    g_free (pipeline);
+
+    rec->appsrc = gst_bin_get_by_name (GST_BIN (rec->pipeline), "src");
+    GstElement *sink = gst_bin_get_by_name (GST_BIN (rec->pipeline), "sink");
+
+    // set this separately, so that we don't need to worry about quoting
+    const char *fn = (*env)->GetStringUTFChars (env, _fn, JNI_FALSE);
+    g_object_set (sink, "location", fn, NULL);
+    (*env)->ReleaseStringUTFChars (env, _fn, fn);
+    gst_object_unref (sink);
+
+    GstCaps *caps = gst_caps_new_simple ("video/x-raw",
+        "format", G_TYPE_STRING, "RGBA",
+        "width", G_TYPE_INT, width,
+        "height", G_TYPE_INT, height,
+        "framerate", GST_TYPE_FRACTION, fps, 1, NULL);
+    // the queue between the render thread and the encoder is bounded by max-bytes
+    g_object_set (rec->appsrc, "caps", caps, "format", GST_FORMAT_TIME,
+        "is-live", TRUE, "max-bytes", rec->max_bytes, "block", (gboolean) block, NULL);
+    gst_caps_unref (caps);
+
+    rec->bus = gst_element_get_bus (rec->pipeline);
+    gst_element_set_state (rec->pipeline, GST_STATE_PLAYING);
+
+    return (intptr_t) rec;
+  }
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1recorderAddFrame
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_RECORDER_T *rec = (GLVIDEO_RECORDER_T *)(intptr_t) handle;
+    GstMessage *msg;
+    GstClockTime now = g_get_monotonic_time () * GST_USECOND;
+
+    // this is called on the render thread, so don't block on the bus
+    msg = gst_bus_pop_filtered (rec->bus, GST_MESSAGE_ERROR);
+    if (msg) {
+      GError *err;
+      gchar *debug_info;
+      gst_message_parse_error (msg, &err, &debug_info);
+      g_printerr ("GLRecorder: %s: %s\n", GST_OBJECT_NAME (msg->src), err->message);
+      g_printerr ("Debugging information: %s\n", debug_info ? debug_info : "none");
+      g_clear_error (&err);
+      g_free (debug_info);
+      gst_message_unref (msg);
+      rec->failed = true;
+    }
+    if (rec->failed) {
+      return;
+    }
+
+    if (rec->num_frames == 0) {
+      rec->start = now;
+    }
+
+    // this is called after Processing's endDraw, at which point the frame has
+    // been resolved into the default framebuffer, whereas a (multisampled)
+    // FBO that might still be bound can't be read from
+    GLint prev_fbo;
+    glGetIntegerv (GL_FRAMEBUFFER_BINDING, &prev_fbo);
+    glBindFramebuffer (GL_FRAMEBUFFER, 0);
+#ifndef GLES2
+    GLint prev_read_buffer;
+    glGetIntegerv (GL_READ_BUFFER, &prev_read_buffer);
+    glReadBuffer (GL_BACK);
+#endif
+
+#ifdef GLES2
+    // no pixel buffer objects in OpenGL ES 2.0, read synchronously
+    if (recorder_queue_full (rec)) {
+      rec->frames_dropped++;
+    } else {
+      GstBuffer *buffer = gst_buffer_new_allocate (NULL, rec->frame_size, NULL);
+      GstMapInfo map;
+      gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+      glReadPixels (0, 0, rec->width, rec->height, GL_RGBA, GL_UNSIGNED_BYTE, map.data);
+      gst_buffer_unmap (buffer, &map);
+      recorder_push_buffer (rec, buffer, now - rec->start);
+    }
+#else
+    if (!rec->pbos[0]) {
+      glGenBuffers (GLVIDEO_RECORDER_PBOS, rec->pbos);
+      g_atomic_int_add (&live_gl_objects, GLVIDEO_RECORDER_PBOS);
+      for (int i=0; i < GLVIDEO_RECORDER_PBOS; i++) {
+        glBindBuffer (GL_PIXEL_PACK_BUFFER, rec->pbos[i]);
+        glBufferData (GL_PIXEL_PACK_BUFFER, rec->frame_size, NULL, GL_STREAM_READ);
+      }
+      glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // the readback into this buffer got started a couple of frames ago, so
+    // mapping it shouldn't stall the pipeline anymore
+    int idx = rec->num_frames % GLVIDEO_RECORDER_PBOS;
+    if (GLVIDEO_RECORDER_PBOS <= rec->num_frames) {
+      recorder_push_pbo (rec, idx);
+    }
+
+    // this returns immediately
+    glBindBuffer (GL_PIXEL_PACK_BUFFER, rec->pbos[idx]);
+    glReadPixels (0, 0, rec->width, rec->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+    rec->pts[idx] = now - rec->start;
+
+    glReadBuffer (prev_read_buffer);
+#endif
+    glBindFramebuffer (GL_FRAMEBUFFER, prev_fbo);
+
+    rec->num_frames++;
+  }
+
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getRecorderStats
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_RECORDER_T *rec = (GLVIDEO_RECORDER_T *)(intptr_t) handle;
+    guint64 level = 0;
+    jlong stats[3];
+
+    g_object_get (rec->appsrc, "current-level-bytes", &level, NULL);
+    stats[0] = rec->frames_recorded;
+    stats[1] = rec->frames_dropped;
+    stats[2] = level / rec->frame_size;
+
+    jlongArray ret = (*env)->NewLongArray (env, 3);
+    (*env)->SetLongArrayRegion (env, ret, 0, 3, stats);
+    return ret;
+  }
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1closeRecorder
+  (JNIEnv * env, jclass cls, jlong handle, jboolean gl_thread) {
+    GLVIDEO_RECORDER_T *rec = (GLVIDEO_RECORDER_T *)(intptr_t) handle;
+    GstFlowReturn ret;
+
+#ifndef GLES2
+    if (rec->pbos[0]) {
+      if (gl_thread) {
+        // push the frames still in flight, in order
+        guint64 pending = MIN (rec->num_frames, GLVIDEO_RECORDER_PBOS);
+        for (guint64 i=rec->num_frames-pending; i < rec->num_frames; i++) {
+          if (!rec->failed) {
+            recorder_push_pbo (rec, i % GLVIDEO_RECORDER_PBOS);
+          }
+        }
+        glDeleteBuffers (GLVIDEO_RECORDER_PBOS, rec->pbos);
+      } else {
+        // without a current context the frames in flight are lost, and the
+        // buffers go away together with Processing's context
+        rec->frames_dropped += MIN (rec->num_frames, GLVIDEO_RECORDER_PBOS);
+      }
+      g_atomic_int_add (&live_gl_objects, -GLVIDEO_RECORDER_PBOS);
+    }
+#endif
+
+    // let the muxer finish the file
+    g_signal_emit_by_name (rec->appsrc, "end-of-stream", &ret);
+    GstMessage *msg = gst_bus_timed_pop_filtered (rec->bus, 10 * GST_SECOND,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    if (!msg || GST_MESSAGE_TYPE (msg) != GST_MESSAGE_EOS) {
+      g_printerr ("GLRecorder: Error finishing the file\n");
+    }
+    if (msg) {
+      gst_message_unref (msg);
+    }
+
+    gst_element_set_state (rec->pipeline, GST_STATE_NULL);
+    gst_object_unref (rec->bus);
+    gst_object_unref (rec->appsrc);
+    gst_object_unref (rec->pipeline);
+
+    free (rec);
+  }
+
+static void
+thumbnail_job (gpointer data, gpointer user_data)
+{
+  GLVIDEO_THUMBNAIL_JOB_T *job = (GLVIDEO_THUMBNAIL_JOB_T *) data;
+  GError *error = NULL;
+  GstStateChangeReturn ret;
+
+  // decode video only, and scale down before converting to ARGB
+  gchar *desc = g_strdup_printf ("playbin flags=%d video-sink=\"videoscale ! videoconvert ! "
+      "capsfilter name=filter ! fakesink name=sink enable-last-sample=true sync=false\"",
+      GST_PLAY_FLAG_VIDEO);
+  GstElement *pipeline = gst_parse_launch (desc, &error);
+  g_free (desc);
+  if (error) {
+    g_printerr ("GLVideo: Could not create thumbnail pipeline: %s\n", error->message);
+    g_error_free (error);
+    if (pipeline) {
+      gst_object_unref (pipeline);
+    }
+    return;
+  }
+
+  GstElement *videosink;
+  g_object_get (pipeline, "video-sink", &videosink, NULL);
+  GstElement *capsfilter = gst_bin_get_by_name (GST_BIN (videosink), "filter");
+  GstElement *sink = gst_bin_get_by_name (GST_BIN (videosink), "sink");
+  gst_object_unref (videosink);
+
+  // this matches Processing's ARGB pixels when read as native ints
+  GstCaps *caps = gst_caps_new_simple ("video/x-raw",
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+      "format", G_TYPE_STRING, "BGRA",
+#else
+      "format", G_TYPE_STRING, "ARGB",
+#endif
+      "width", G_TYPE_INT, job->width,
+      "height", G_TYPE_INT, job->height,
+      "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
+  g_object_set (capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  gst_object_unref (capsfilter);
+
+  g_object_set (pipeline, "uri", job->uri, NULL);
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  ret = gst_element_get_state (pipeline, NULL, NULL, 10 * GST_SECOND);
+
+  // the same pipeline is reused for all timestamps of a file
+  for (int i=0; ret != GST_STATE_CHANGE_FAILURE && i < job->num_times; i++) {
+    GstSeekFlags flags = GST_SEEK_FLAG_FLUSH;
+    if (job->exact) {
+      flags |= GST_SEEK_FLAG_ACCURATE;
+    } else {
+      // only decode the closest keyframe
+      flags |= GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_NEAREST | GST_SEEK_FLAG_TRICKMODE_KEY_UNITS;
+    }
+    if (!gst_element_seek_simple (pipeline, GST_FORMAT_TIME, flags, job->times[i])) {
+      continue;
+    }
+    ret = gst_element_get_state (pipeline, NULL, NULL, 10 * GST_SECOND);
+    if (ret == GST_STATE_CHANGE_FAILURE) {
+      break;
+    }
+
+    GstSample *sample = NULL;
+    g_object_get (sink, "last-sample", &sample, NULL);
+    if (!sample) {
+      continue;
+    }
+    GstBuffer *buffer = gst_sample_get_buffer (sample);
+    GstMapInfo map;
+    gsize size = (gsize) job->width * job->height * 4;
+    if (buffer && gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+      if (size <= map.size) {
+        // g_memdup is deprecated since GLib 2.68, and takes a guint size
+        job->results[i] = g_malloc (size);
+        memcpy (job->results[i], map.data, size);
+      }
+      gst_buffer_unmap (buffer, &map);
+    }
+    gst_sample_unref (sample);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+}
+
+JNIEXPORT jobjectArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1extractThumbnails
+  (JNIEnv * env, jclass cls, jobjectArray _uris, jfloatArray _times, jint width, jint height, jboolean exact, jint threads) {
+    jsize num_uris = (*env)->GetArrayLength (env, _uris);
+    jsize num_times = (*env)->GetArrayLength (env, _times);
+    GLVIDEO_THUMBNAIL_JOB_T *jobs = g_new0 (GLVIDEO_THUMBNAIL_JOB_T, num_uris);
+    gint64 *times = g_new (gint64, num_times);
+    GError *error = NULL;
+
+    jfloat *sec = (*env)->GetFloatArrayElements (env, _times, NULL);
+    for (jsize i=0; i < num_times; i++) {
+      times[i] = (gint64)(sec[i] * GST_SECOND);
+    }
+    (*env)->ReleaseFloatArrayElements (env, _times, sec, JNI_ABORT);
+
+    // one job per file, run across a pool of worker threads
+    GThreadPool *pool = g_thread_pool_new (thumbnail_job, NULL, MAX (threads, 1), TRUE, &error);
+    if (!pool) {
+      g_printerr ("GLVideo: Could not create thread pool: %s\n", error ? error->message : "unknown error");
+      g_clear_error (&error);
+    }
+    for (jsize i=0; i < num_uris; i++) {
+      jstring _uri = (jstring) (*env)->GetObjectArrayElement (env, _uris, i);
+      const char *uri = (*env)->GetStringUTFChars (env, _uri, JNI_FALSE);
+      jobs[i].uri = g_strdup (uri);
+      (*env)->ReleaseStringUTFChars (env, _uri, uri);
+      (*env)->DeleteLocalRef (env, _uri);
+      jobs[i].times = times;
+      jobs[i].num_times = num_times;
+      jobs[i].width = width;
+      jobs[i].height = height;
+      jobs[i].exact = exact;
+      jobs[i].results = g_new0 (guint32 *, num_times);
+      if (pool) {
+        g_thread_pool_push (pool, &jobs[i], NULL);
+      }
+    }
+    if (pool) {
+      // this waits for all jobs to finish
+      g_thread_pool_free (pool, FALSE, TRUE);
+    }
+
+    // file-major, with null for thumbnails that couldn't be extracted
+    jclass intArrayClass = (*env)->FindClass (env, "[I");
+    jobjectArray ret = (*env)->NewObjectArray (env, num_uris * num_times, intArrayClass, NULL);
+    for (jsize i=0; i < num_uris; i++) {
+      for (jsize j=0; j < num_times; j++) {
+        if (jobs[i].results[j]) {
+          jintArray pixels = (*env)->NewIntArray (env, width * height);
+          (*env)->SetIntArrayRegion (env, pixels, 0, width * height, (jint *) jobs[i].results[j]);
+          (*env)->SetObjectArrayElement (env, ret, i * num_times + j, pixels);
+          (*env)->DeleteLocalRef (env, pixels);
+          g_free (jobs[i].results[j]);
+        }
+      }
+      g_free (jobs[i].results);
+      g_free (jobs[i].uri);
+    }
+    g_free (jobs);
+    g_free (times);
+
+    return ret;
+  }
+
+typedef float v4sf __attribute__ ((vector_size (16)));
+
+static void
+warp_points (const float * mat, const float * src, float * dst, int count)
+{
+  int i = 0;
+
+  // four points at a time
+  for (; i + 4 <= count; i += 4) {
+    const float *s = src + i * 2;
+    v4sf x = { s[0], s[2], s[4], s[6] };
+    v4sf y = { s[1], s[3], s[5], s[7] };
+    v4sf w = x * mat[3] + y * mat[7] + mat[15];
+    v4sf dx = (x * mat[0] + y * mat[4] + mat[12]) / w;
+    v4sf dy = (x * mat[1] + y * mat[5] + mat[13]) / w;
+    float *d = dst + i * 2;
+    d[0] = dx[0]; d[1] = dy[0];
+    d[2] = dx[1]; d[3] = dy[1];
+    d[4] = dx[2]; d[5] = dy[2];
+    d[6] = dx[3]; d[7] = dy[3];
+  }
+  for (; i < count; i++) {
+    float x = src[i * 2];
+    float y = src[i * 2 + 1];
+    float w = x * mat[3] + y * mat[7] + mat[15];
+    dst[i * 2] = (x * mat[0] + y * mat[4] + mat[12]) / w;
+    dst[i * 2 + 1] = (x * mat[1] + y * mat[5] + mat[13]) / w;
+  }
+}
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1warpPoints
+  (JNIEnv * env, jclass cls, jfloatArray _mat, jfloatArray _src, jfloatArray _dst, jint count) {
+    jfloat mat[16];
+
+    // the critical section below doesn't do any bounds checking
+    if (count < 0 || (*env)->GetArrayLength (env, _mat) != 16 ||
+        (*env)->GetArrayLength (env, _src) < (jlong) count * 2 ||
+        (*env)->GetArrayLength (env, _dst) < (jlong) count * 2) {
+      jclass exception = (*env)->FindClass (env, "java/lang/IllegalArgumentException");
+      (*env)->ThrowNew (env, exception, "Invalid array lengths for warpPoints");
+      return;
+    }
+
+    (*env)->GetFloatArrayRegion (env, _mat, 0, 16, mat);
+    // this avoids copying the arrays, src and dst may be the same
+    jfloat *src = (*env)->GetPrimitiveArrayCritical (env, _src, NULL);
+    jfloat *dst = (*env)->GetPrimitiveArrayCritical (env, _dst, NULL);
+    warp_points (mat, src, dst, count);
+    (*env)->ReleasePrimitiveArrayCritical (env, _dst, dst, 0);
+    (*env)->ReleasePrimitiveArrayCritical (env, _src, src, JNI_ABORT);
+  }
+
+JNIEXPORT jlong JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1openAtlas
+  (JNIEnv * env, jclass cls, jint width, jint height) {
+    GLVIDEO_ATLAS_T *atlas = g_new0 (GLVIDEO_ATLAS_T, 1);
+    atlas->refcount = 1;
+    atlas->width = width;
+    atlas->height = height;
+    g_mutex_init (&atlas->lock);
+    atlas->tiles = g_array_new (FALSE, TRUE, sizeof (GLVIDEO_ATLAS_TILE_T));
+    return (intptr_t) atlas;
+  }
+
+JNIEXPORT jboolean JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1addToAtlas
+  (JNIEnv * env, jclass cls, jlong handle, jlong video, jint x, jint y, jint width, jint height) {
+    GLVIDEO_ATLAS_T *atlas = (GLVIDEO_ATLAS_T *)(intptr_t) handle;
+    GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *)(intptr_t) video;
+    GLVIDEO_ATLAS_TILE_T tile;
+
+    // keep the rectangle inside the atlas
+    memset (&tile, 0, sizeof (tile));
+    tile.state = state;
+    tile.rect[0] = CLAMP (x, 0, atlas->width);
+    tile.rect[1] = CLAMP (y, 0, atlas->height);
+    tile.rect[2] = CLAMP (width, 0, atlas->width - tile.rect[0]);
+    tile.rect[3] = CLAMP (height, 0, atlas->height - tile.rect[1]);
+
+    g_mutex_lock (&state->buffer_lock);
+    if (state->atlas && state->atlas != atlas) {
+      g_mutex_unlock (&state->buffer_lock);
+      g_printerr ("GLVideo: A video can only be part of one atlas\n");
+      return JNI_FALSE;
+    }
+    if (!state->atlas) {
+      g_atomic_int_inc (&atlas->refcount);
+      state->atlas = atlas;
+    }
+    state->atlas_width = tile.rect[2];
+    state->atlas_height = tile.rect[3];
+    g_mutex_unlock (&state->buffer_lock);
+
+    g_mutex_lock (&atlas->lock);
+    g_array_append_val (atlas->tiles, tile);
+    g_mutex_unlock (&atlas->lock);
+
+    // have glcolorscale scale the frames to the rectangle, on the GPU
+    if ((state->flags & gohai_glvideo_GLVideo_SCALABLE) && tile.rect[2] && tile.rect[3]) {
+      GstCaps *caps = gst_caps_from_string ("video/x-raw(memory:GLMemory),format=RGBA,texture-target=2D");
+      gst_caps_set_simple (caps, "width", G_TYPE_INT, tile.rect[2],
+          "height", G_TYPE_INT, tile.rect[3], NULL);
+      g_object_set (state->filter, "caps", caps, NULL);
+      gst_caps_unref (caps);
+    }
+    return JNI_TRUE;
+  }
+
+JNIEXPORT jint JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1updateAtlas
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_ATLAS_T *atlas = (GLVIDEO_ATLAS_T *)(intptr_t) handle;
+    GLuint tex;
+
+    // this runs with Processing's context current, the copies themselves
+    // already happened on the streaming threads
+    g_mutex_lock (&atlas->lock);
+    if (atlas->context) {
+      const GstGLFuncs *gl = atlas->context->gl_vtable;
+      for (guint i=0; i < atlas->tiles->len; i++) {
+        GLVIDEO_ATLAS_TILE_T *tile = &g_array_index (atlas->tiles, GLVIDEO_ATLAS_TILE_T, i);
+        if (tile->sync) {
+          // this makes the GPU wait, not the sketch
+          gl->WaitSync (tile->sync, 0, GL_TIMEOUT_IGNORED);
+          gl->DeleteSync (tile->sync);
+          tile->sync = NULL;
+          atlas->waits++;
+        }
+      }
+    }
+    tex = atlas->tex;
+    g_mutex_unlock (&atlas->lock);
+    return tex;
+  }
+
+JNIEXPORT jlongArray JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1getAtlasStats
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_ATLAS_T *atlas = (GLVIDEO_ATLAS_T *)(intptr_t) handle;
+    jlong stats[4];
+
+    g_mutex_lock (&atlas->lock);
+    stats[0] = atlas->copies;
+    // in us, measured on the streaming threads
+    stats[1] = (atlas->copies) ? atlas->copy_time / atlas->copies : 0;
+    stats[2] = atlas->copy_time_max;
+    stats[3] = atlas->waits;
+    g_mutex_unlock (&atlas->lock);
+
+    jlongArray ret = (*env)->NewLongArray (env, 4);
+    (*env)->SetLongArrayRegion (env, ret, 0, 4, stats);
+    return ret;
+  }
+
+JNIEXPORT void JNICALL Java_gohai_glvideo_GLVideo_gstreamer_1closeAtlas
+  (JNIEnv * env, jclass cls, jlong handle) {
+    GLVIDEO_ATLAS_T *atlas = (GLVIDEO_ATLAS_T *)(intptr_t) handle;
+
+    // the videos go back to handing their frames to the sketch
+    g_mutex_lock (&atlas->lock);
+    for (guint i=0; i < atlas->tiles->len; i++) {
+      GLVIDEO_ATLAS_TILE_T *tile = &g_array_index (atlas->tiles, GLVIDEO_ATLAS_TILE_T, i);
+      GLVIDEO_STATE_T *state = (GLVIDEO_STATE_T *) tile->state;
+      if (!state) {
+        continue;
+      }
+      g_mutex_lock (&state->buffer_lock);
+      bool scaled = (state->atlas == atlas && state->atlas_width);
+      if (state->atlas == atlas) {
+        state->atlas = NULL;
+        state->atlas_width = 0;
+        state->atlas_height = 0;
+        // not the last reference, the handle still holds one
+        g_atomic_int_add (&atlas->refcount, -1);
+      }
+      g_mutex_unlock (&state->buffer_lock);
+      if (scaled && (state->flags & gohai_glvideo_GLVideo_SCALABLE)) {
+        // back to the video's own size
+        GstCaps *caps = gst_caps_from_string ("video/x-raw(memory:GLMemory),format=RGBA,texture-target=2D");
+        g_object_set (state->filter, "caps", caps, NULL);
+        gst_caps_unref (caps);
+      }
+      tile->state = NULL;
+    }
+    g_mutex_unlock (&atlas->lock);
+
+    atlas_unref (atlas);
   }
@@ -1,25 +1,201 @@
 #ifndef GLUE_H
 #define GLUE_H
 
+// read by Java through a direct ByteBuffer, see publish_frame_desc
+typedef struct {
+  // odd while being written
+  volatile gint32 seq;
+  gint32 tex;
+  gint32 width;
+  gint32 height;
+  gint32 playing;
+  gint32 reserved;
+  gint64 pts;
+  gint64 position;
+  gint64 duration;
+  gint64 frames;
+  gint64 missed;
+} GLVIDEO_FRAME_DESC_T;
+
+typedef struct {
+  GstClockID id;
+  // GLVIDEO_STATE_T, as passed to Java
+  gint64 handle;
+  guint index;
+  // the cue's own time, passed to cueEvent
+  GstClockTime stream_time;
+  // set by cue_cb
+  gint fired;
+} GLVIDEO_CUE_T;
+
+typedef struct {
+  // GLVIDEO_STATE_T, NULL once the video is closed
+  gpointer state;
+  int rect[4];
+  // fence after the last copy, waited on by updateAtlas
+  GLsync sync;
+} GLVIDEO_ATLAS_TILE_T;
+
+typedef struct {
+  // one for the handle, one for every attached video and copy in progress
+  gint refcount;
+  int width;
+  int height;
+
+  GMutex lock;
+  // protects the following
+  // context the texture was created on, also used to delete it
+  GstGLContext *context;
+  GLuint tex;
+  GArray *tiles;
+  guint64 copies;
+  gint64 copy_time;
+  gint64 copy_time_max;
+  guint64 waits;
+} GLVIDEO_ATLAS_T;
+
 typedef struct {
   GstElement *pipeline;
   GstElement *vsink;
+  GstElement *filter;
+  // only for capture devices
+  GstElement *videorate;
   GstCaps *caps;
 
   GstGLContext *gl_context;
+  GstGLContext *shared_context;
+  int shared_context_idx;
 
   GMutex buffer_lock;
   // protects the following
   GstBuffer *current_buffer;
   GLuint current_tex;
+  GstClockTime current_pts;
   GstBuffer *next_buffer;
   GLuint next_tex;
+  GstClockTime next_pts;
+  // incremented for every new frame, signals frame_cond
+  guint64 frame_serial;
+  GCond frame_cond;
+
+  GHashTable *textures;
+  gchar *decoder;
+  int width;
+  int height;
+  // only written by getFrame
+  gint64 duration;
+  int duration_queries;
+  GLVIDEO_FRAME_DESC_T desc;
+  // sorted stream times, see schedule_cues
+  GArray *cues;
+  guint cue_next;
+  GList *cue_pending;
+  GstSegment segment;
+  // glshader elements in front of filter, NULL once removed
+  GPtrArray *shaders;
+  // see analysis_cb
+  GLVIDEO_ANALYSIS_T analysis;
+  // frames are copied into this instead of being handed to the sketch
+  GLVIDEO_ATLAS_T *atlas;
+  int atlas_width;
+  int atlas_height;
+  // only used on the streaming thread, see atlas_copy_cb
+  GLuint atlas_fbo;
+  GstGLContext *atlas_fbo_context;
+  bool playing_requested;
+  bool buffering;
+  int buffering_low;
+  int buffering_high;
+  int buffering_percent;
+  int buffering_events;
+  gint64 buffering_since;
+  gint64 buffering_time;
+  int buffering_avg_in;
+  int buffering_avg_out;
+  gint64 buffering_left;
+  // counters for the adaptive quality controller, reset by adaptive_cb
+  gint64 next_since;
+  int frames_produced;
+  int frames_missed;
+  int frames_consumed;
+  gint64 consume_latency;
+  int qos_events;
+  gint64 max_lateness;
+  // the sketch's frameCount at the last getFrame, and at the last interval
+  int sketch_frame;
+  int sketch_frame_prev;
+  // totals, since the pipeline was opened
+  guint64 total_missed;
+  guint64 total_qos_events;
+  gint64 avg_consume_latency;
+  gint64 last_lateness;
 
   int flags;
+  // when createGlPipeline was called, for the resource accounting
+  gint64 open_time;
+  int pool_min_buffers;
+  int pool_max_buffers;
 
   bool looping;
   float rate;
-  bool buffering;
+
+  // adaptive quality, see adaptive_cb, only used on the main loop thread
+  // except for quality, quality_down, quality_up and trick_flags, which
+  // are written under buffer_lock
+  guint adaptive_source;
+  int quality;
+  int quality_down;
+  int quality_up;
+  int headroom;
+  int cooldown;
+  int native_width;
+  int native_height;
+  int native_fps;
+  GstSeekFlags trick_flags;
 } GLVIDEO_STATE_T;
 
+// see invoke_on_main_loop
+typedef struct {
+  GSourceFunc func;
+  gpointer data;
+  GMutex lock;
+  GCond cond;
+  bool done;
+} GLVIDEO_INVOKE_T;
+
+#define GLVIDEO_RECORDER_PBOS 3
+
+typedef struct {
+  GstElement *pipeline;
+  GstElement *appsrc;
+  GstBus *bus;
+
+  int width;
+  int height;
+  gsize frame_size;
+  guint64 max_bytes;
+  bool block;
+  bool failed;
+
+  // pixel buffer objects, used round-robin
+  GLuint pbos[GLVIDEO_RECORDER_PBOS];
+  GstClockTime pts[GLVIDEO_RECORDER_PBOS];
+  guint64 num_frames;
+  GstClockTime start;
+
+  guint64 frames_recorded;
+  guint64 frames_dropped;
+} GLVIDEO_RECORDER_T;
+
+typedef struct {
+  gchar *uri;
+  gint64 *times;
+  int num_times;
+  int width;
+  int height;
+  bool exact;
+  // ARGB pixels, or NULL
+  guint32 **results;
+} GLVIDEO_THUMBNAIL_JOB_T;
+
 #endif